@@ -29,6 +29,7 @@ lhs_enumerator_library_t::lhs_enumerator_library_t()
 {
     add("depth", new lhs::depth_based_enumerator_t::generator_t());
     add("a*", new lhs::a_star_based_enumerator_t::generator_t());
+    add("beam", new lhs::beam_enumerator_t::generator_t());
 }
 
 
@@ -166,7 +167,8 @@ void execute(
 
         kb::kb()->prepare_compile();
 
-        processor.add_component(new proc::compile_kb_t());
+        processor.add_component(
+            new proc::compile_kb_t(phillip->param_int("kb_thread_num", 1)));
         processor.process(inputs);
 
         kb::kb()->finalize();
@@ -174,6 +176,23 @@ void execute(
         util::print_console("Completed to compile knowledge-base.");
     }
 
+    /* COMPILING OBSERVATIONS */
+    if (config.mode == bin::EXE_MODE_COMPILE_OBS)
+    {
+        const std::string &path = phillip->param("path_obs_out");
+        if (path.empty())
+            throw phillip_exception_t(
+            "The path of compiled observations is not specified. Use \"-o obs=<PATH>\".", true);
+
+        proc::processor_t processor;
+        util::print_console("Compiling observations ...");
+
+        processor.add_component(new proc::compile_obs_t(path));
+        processor.process(inputs);
+
+        util::print_console("Completed to compile observations.");
+    }
+
     auto proc = [&](const lf::input_t &ipt)
     {
         if (config.mode == bin::EXE_MODE_INFERENCE)
@@ -186,67 +205,135 @@ void execute(
     if (config.mode == bin::EXE_MODE_INFERENCE or
         config.mode == bin::EXE_MODE_LEARNING)
     {
-        std::vector<lf::input_t> parsed_inputs;
-        proc::processor_t processor;
+        util::bounded_queue_t<lf::input_t> queue(
+            phillip->param_int("obs_queue_size", 64));
+        std::exception_ptr error;
         bool flag_printing(false);
+        int num_obs(0);
 
         util::print_console("Loading observations ...");
 
-        processor.add_component(new proc::parse_obs_t(&parsed_inputs));
-        processor.process(inputs);
+        /* OBSERVATIONS ARE PARSED IN ANOTHER THREAD AND ARE PASSED THROUGH THE QUEUE,
+         * SO THAT INFERENCE CAN START BEFORE ALL INPUTS ARE LOADED. */
+        std::thread loader([&]()
+        {
+            try
+            {
+                proc::processor_t processor;
+                processor.add_component(new proc::parse_obs_t(&queue));
 
-        util::print_console("Completed to load observations.");
-        util::print_console_fmt("    # of observations: %d", parsed_inputs.size());
+                if (inputs.empty())
+                    processor.process(inputs);
 
-        kb::kb()->prepare_query();
-        phillip->check_validity();
+                for (const auto &path : inputs)
+                {
+                    if (proc::compiled_obs_reader_t::is_compiled(path))
+                    {
+                        proc::compiled_obs_reader_t reader(path);
+                        for (lf::input_t ipt; reader.next(&ipt);)
+                            if (not queue.push(ipt))
+                                throw phillip_exception_t("Loading observations has been aborted.");
+                    }
+                    else
+                        processor.process(inputs_t(1, path));
+                }
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            queue.close();
+        });
+
+        /* IN PIPELINE MODE, EACH STAGE OF INFERENCE RUNS ON ITS OWN THREADS
+         * AND THE RESULTS ARE WRITTEN IN THE ORDER OF OBSERVATIONS. */
+        std::unique_ptr<inference_pipeline_t> pipeline;
+        bool do_pipeline =
+            (config.mode == bin::EXE_MODE_INFERENCE) and phillip->flag("pipeline");
 
-        // SOLVE EACH OBSERVATION
-        for (int i = 0; i < parsed_inputs.size(); ++i)
+        try
         {
-            const lf::input_t &ipt = parsed_inputs.at(i);
+            kb::kb()->prepare_query();
+            phillip->check_validity();
 
-            std::string obs_name = ipt.name;
-            if (obs_name.rfind("::") != std::string::npos)
-                obs_name = obs_name.substr(obs_name.rfind("::") + 2);
+            if (do_pipeline)
+            {
+                pipeline.reset(new inference_pipeline_t(
+                    phillip, [](const phillip_main_t *ph)
+                {
+                    auto &sols = ph->get_solutions();
+                    for (auto sol = sols.begin(); sol != sols.end(); ++sol)
+                        sol->print_graph();
+                }));
+            }
 
-            if (phillip->is_target(obs_name) and
-                not phillip->is_excluded(obs_name))
+            // SOLVE EACH OBSERVATION
+            for (lf::input_t ipt; queue.pop(&ipt); ++num_obs)
             {
-                if (not flag_printing)
+                std::string obs_name = ipt.name;
+                if (obs_name.rfind("::") != std::string::npos)
+                    obs_name = obs_name.substr(obs_name.rfind("::") + 2);
+
+                if (phillip->is_target(obs_name) and
+                    not phillip->is_excluded(obs_name))
                 {
-                    phillip->write_header();
-                    flag_printing = true;
-                }
+                    if (not flag_printing)
+                    {
+                        phillip->write_header();
+                        flag_printing = true;
+                    }
 
-                util::print_console_fmt("Observation #%d: %s", i, ipt.name.c_str());
-                kb::kb()->clear_distance_cache();
+                    util::print_console_fmt("Observation #%d: %s", num_obs, ipt.name.c_str());
+
+                    if (do_pipeline)
+                    {
+                        pipeline->push(ipt);
+                        continue;
+                    }
 
 #ifdef _DEBUG
-                /* DO NOT HANDLE EXCEPTIONS TO LET THE DEBUGGER CATCH AN EXCEPTION. */
-                proc(ipt);
-#else
-                try
-                {
+                    /* DO NOT HANDLE EXCEPTIONS TO LET THE DEBUGGER CATCH AN EXCEPTION. */
                     proc(ipt);
-                }
-                catch (const std::exception &e)
-                {
-                    util::print_warning_fmt(
-                        "Some exception was caught and then the observation \"%s\" was skipped.", obs_name.c_str());
-                    util::print_warning_fmt("  -> what(): %s", e.what());
-                    continue;
-                }
+#else
+                    try
+                    {
+                        proc(ipt);
+                    }
+                    catch (const std::exception &e)
+                    {
+                        util::print_warning_fmt(
+                            "Some exception was caught and then the observation \"%s\" was skipped.", obs_name.c_str());
+                        util::print_warning_fmt("  -> what(): %s", e.what());
+                        continue;
+                    }
 #endif
-            }
+                }
 
-            auto sols = phillip->get_solutions();
-            for (auto sol = sols.begin(); sol != sols.end(); ++sol)
-                sol->print_graph();
+                auto sols = phillip->get_solutions();
+                for (auto sol = sols.begin(); sol != sols.end(); ++sol)
+                    sol->print_graph();
+            }
         }
+        catch (...)
+        {
+            queue.close();
+            loader.join();
+            throw;
+        }
+
+        if (pipeline)
+            pipeline->close();
+
+        loader.join();
+
+        util::print_console("Completed to load observations.");
+        util::print_console_fmt("    # of observations: %d", num_obs);
 
         if (flag_printing)
             phillip->write_footer();
+
+        if (error)
+            std::rethrow_exception(error);
     }
 }
 
@@ -393,6 +480,8 @@ bool _interpret_option(
                 config->mode = EXE_MODE_COMPILE_KB;
             else if (arg == "learning" or arg == "learn")
                 config->mode = EXE_MODE_LEARNING;
+            else if (arg == "compile_obs")
+                config->mode = EXE_MODE_COMPILE_OBS;
             else
                 config->mode = EXE_MODE_UNDERSPECIFIED;
         }
@@ -424,6 +513,18 @@ bool _interpret_option(
                 phillip->set_param("path_sol_out", util::normalize_path(val));
                 return true;
             }
+            else if (key == "obs")
+            {
+                phillip->set_param("path_obs_out", util::normalize_path(val));
+                return true;
+            }
+            else if (key == "format")
+            {
+                if (val != "xml" and val != "jsonl" and val != "bin")
+                    return false;
+                phillip->set_param("output_format", val);
+                return true;
+            }
             else
                 return false;
         }
@@ -506,6 +607,12 @@ bool _interpret_option(
                 phillip->set_param("gurobi_thread_num", spl[1]);
                 return true;
             }
+            else if (spl[0] == "lhs" or spl[0] == "ilp" or spl[0] == "sol")
+            {
+                phillip->set_param("pipeline_" + spl[0] + "_thread_num", spl[1]);
+                phillip->set_flag("pipeline");
+                return true;
+            }
             else
                 return false;
         }
@@ -557,6 +664,8 @@ bool preprocess(const execution_configure_t &config, phillip_main_t *phillip)
     float max_dist = phillip->param_float("kb_max_distance", -1.0);
     int thread_num = phillip->param_int("kb_thread_num", 1);
     bool disable_stop_word = phillip->flag("disable_stop_word");
+    int cache_size = phillip->param_int("kb_cache_size", 10000);
+    int dist_cache_size = phillip->param_int("kb_distance_cache_size", 262144);
     std::string dist_key = config.dist_key.empty() ? "basic" : config.dist_key;
     std::string tab_key = config.tab_key.empty() ? "null" : config.tab_key;
 
@@ -575,8 +684,23 @@ bool preprocess(const execution_configure_t &config, phillip_main_t *phillip)
         ilp_solver_library_t::instance()->
         generate(config.sol_key, phillip);
 
+    if (phillip->flag("disable_kb_mmap"))
+        util::cdb_data_t::disable_mmap();
+
+    if (phillip->flag("verify_kb"))
+        kb::knowledge_base_t::enable_container_verification();
+
+    if (phillip->param_int("kb_buffer_size") > 0)
+        kb::knowledge_base_t::set_query_map_buffer_size(
+        (size_t)phillip->param_int("kb_buffer_size") << 20);
+
+    if (phillip->param_int("kb_pattern_table_size") > 0)
+        kb::knowledge_base_t::set_max_interned_patterns(
+        (size_t)phillip->param_int("kb_pattern_table_size"));
+
     kb::knowledge_base_t::setup(
-        config.kb_name, max_dist, thread_num, disable_stop_word);
+        config.kb_name, max_dist, thread_num, disable_stop_word,
+        cache_size, dist_cache_size);
     kb::knowledge_base_t::instance()->set_distance_provider(dist_key, phillip);
     kb::knowledge_base_t::instance()->set_category_table(tab_key, phillip);
 
@@ -589,6 +713,7 @@ bool preprocess(const execution_configure_t &config, phillip_main_t *phillip)
         if (sol != NULL) phillip->set_ilp_solver(sol);
         return true;
     case EXE_MODE_COMPILE_KB:
+    case EXE_MODE_COMPILE_OBS:
         return true;
     default:
         return false;
@@ -607,6 +732,7 @@ void print_usage()
         "    -m {compile_kb|compile} : Compiling knowledge-base mode.",
         "    -m {inference|infer} : Inference mode.",
         "    -m {learning|learn} : Learning mode.",
+        "    -m compile_obs : Compiling observations into a binary file mode.",
         "",
         "  Common Options:",
         "    -l <NAME> : Loads a config-file.",
@@ -621,6 +747,9 @@ void print_usage()
         "    -c tab=<NAME> : Sets a component for making category-table.",
         "    -k <NAME> : Sets the prefix of the path of the compiled knowledge base.",
         "",
+        "  Options in compile_obs mode:",
+        "    -o obs=<PATH> : Writes the compiled observations to the given file path.",
+        "",
         "  Options in inference-mode or learning-mode:",
         "    -c lhs=<NAME> : Sets a component for making latent hypotheses sets.",
         "    -c ilp=<NAME> : Sets a component for making ILP problems.",
@@ -630,14 +759,21 @@ void print_usage()
         "    -o lhs=<PATH> : Prints the XML of the latent hypothesis set for debug to the given file path.",
         "    -o ilp=<PATH> : Prints the XML of the ILP problem for debug to the given file path.",
         "    -o sol=<PATH> : Prints the XML of the ILP solution for debug to the given file path.",
+        "    -o format={xml|jsonl|bin} : Sets the format of the output by -o <PATH>.",
+        "    [INPUTS] may include files made in compile_obs mode.",
         "    -t <NAME> : Solves only the observation of corresponding name.",
         "    -t !<NAME> : Excludes the observation which corresponds with given name.",
         "    -G : Forces to satisfy the requirements.",
         "    -H : Adds the human readable hypothesis to output XMLs.",
+        "    -f compact_output : Omits inactive literals and edges from output XMLs.",
         "    -T <INT>  : Sets timeout of the whole inference in seconds.",
         "    -T lhs=<INT> : Sets timeout of the creation of latent hypotheses sets in seconds.",
         "    -T ilp=<INT> : Sets timeout of the conversion into ILP problem in seconds.",
         "    -T sol=<INT> : Sets timeout of the optimization of ILP problem in seconds.",
+        "    -f pipeline : Runs the stages of inference of successive observations concurrently.",
+        "                  Names of unknown terms and equality nodes among them may differ",
+        "                  from those in sequential inference.",
+        "    -P {lhs|ilp|sol}=<INT> : Sets the number of threads for each stage in pipeline mode.",
         "",
         "  Wiki: https://github.com/kazeto/phillip/wiki"};
 
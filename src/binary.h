@@ -29,7 +29,8 @@ enum execution_mode_e
     EXE_MODE_INFERENCE,
     EXE_MODE_LEARNING,
     EXE_MODE_HELP,
-    EXE_MODE_COMPILE_KB
+    EXE_MODE_COMPILE_KB,
+    EXE_MODE_COMPILE_OBS
 };
 
 
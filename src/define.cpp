@@ -3,6 +3,10 @@
 #include <cstring>
 #include <cassert>
 #include <errno.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <queue>
 
 #include "./define.h"
 
@@ -10,6 +14,9 @@
 #include <direct.h>
 #else
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 const int FAILURE_MKDIR = -1;
@@ -21,7 +28,7 @@ namespace phil
 std::mutex string_hash_t::ms_mutex_hash;
 std::mutex string_hash_t::ms_mutex_unknown;
 hash_map<std::string, unsigned> string_hash_t::ms_hashier;
-std::vector<std::string> string_hash_t::ms_strs;
+std::deque<std::string> string_hash_t::ms_strs;
 unsigned string_hash_t::ms_issued_variable_count = 0;
 
 
@@ -221,8 +228,11 @@ namespace util
 {
 
 
+bool cdb_data_t::ms_do_use_mmap = true;
+
+
 cdb_data_t::cdb_data_t(std::string _filename)
-    : m_filename(_filename), m_fout(NULL), m_fin(NULL),
+    : m_filename(_filename), m_fout(NULL), m_fin(NULL), m_map(NULL),
       m_builder(NULL), m_finder(NULL)
 {}
 
@@ -255,6 +265,24 @@ void cdb_data_t::prepare_query()
 {
     if (is_writable()) finalize();
 
+    if (not is_readable() and ms_do_use_mmap)
+    {
+        m_map = new mapped_file_t();
+        if (not m_map->open(m_filename))
+            throw phillip_exception_t(
+            "Failed to open a database file: " + m_filename);
+
+        try
+        {
+            m_finder = new cdbpp::cdbpp(m_map->data(), m_map->size(), false);
+        }
+        catch (const cdbpp::cdbpp_exception&)
+        {
+            throw phillip_exception_t(
+                "Failed to read a database file: " + m_filename);
+        }
+    }
+
     if (not is_readable())
     {
         m_fin = new std::ifstream(
@@ -274,6 +302,22 @@ void cdb_data_t::prepare_query()
 }
 
 
+void cdb_data_t::prepare_query(const void *data, size_t size)
+{
+    if (is_writable() or is_readable()) finalize();
+
+    try
+    {
+        m_finder = new cdbpp::cdbpp(data, size, false);
+    }
+    catch (const cdbpp::cdbpp_exception&)
+    {
+        throw phillip_exception_t(
+            "Failed to read a database: " + m_filename);
+    }
+}
+
+
 void cdb_data_t::finalize()
 {
     if (m_builder != NULL)
@@ -298,6 +342,289 @@ void cdb_data_t::finalize()
         delete m_fin;
         m_fin = NULL;
     }
+
+    if (m_map != NULL)
+    {
+        delete m_map;
+        m_map = NULL;
+    }
+}
+
+
+cancellation_token_t::cancellation_token_t()
+    : m_has_deadline(false),
+      m_is_stopped(false), m_is_cancelled(false), m_num_polled(0)
+{}
+
+
+void cancellation_token_t::reset()
+{
+    m_has_deadline = false;
+    m_is_stopped.store(false, std::memory_order_relaxed);
+    m_is_cancelled.store(false, std::memory_order_relaxed);
+    m_num_polled.store(0, std::memory_order_relaxed);
+}
+
+
+void cancellation_token_t::start(duration_time_t timeout)
+{
+    m_has_deadline = (timeout > 0.0f);
+    if (m_has_deadline)
+        m_deadline = std::chrono::system_clock::now() +
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+        std::chrono::duration<double>(timeout));
+
+    m_is_stopped.store(false, std::memory_order_relaxed);
+    m_num_polled.store(0, std::memory_order_relaxed);
+}
+
+
+bool cancellation_token_t::check() const
+{
+    if (is_cancelled()) return true;
+
+    if (m_has_deadline and std::chrono::system_clock::now() >= m_deadline)
+    {
+        m_is_stopped.store(true, std::memory_order_relaxed);
+        return true;
+    }
+    else
+        return false;
+}
+
+
+memory_istream_t::buffer_t::buffer_t(const char *data, size_t size)
+{
+    char *p = const_cast<char*>(data);
+    setg(p, p, p + size);
+}
+
+
+std::streambuf::pos_type memory_istream_t::buffer_t::seekoff(
+    off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    char *p;
+
+    if (dir == std::ios_base::beg) p = eback() + off;
+    else if (dir == std::ios_base::cur) p = gptr() + off;
+    else p = egptr() + off;
+
+    if (not (which & std::ios_base::in) or p < eback() or p > egptr())
+        return pos_type(off_type(-1));
+
+    setg(eback(), p, egptr());
+    return pos_type(p - eback());
+}
+
+
+std::streambuf::pos_type memory_istream_t::buffer_t::seekpos(
+    pos_type pos, std::ios_base::openmode which)
+{
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+memory_istream_t::memory_istream_t(const char *data, size_t size)
+    : std::istream(NULL), m_buffer(data, size)
+{
+    rdbuf(&m_buffer);
+}
+
+
+bool mapped_file_t::open(const std::string &filename, bool do_map)
+{
+    close();
+
+#ifndef _WIN32
+    if (not do_map)
+#endif
+    {
+        // THE WHOLE FILE IS READ ON HEAP.
+        std::ifstream fin(filename.c_str(), std::ios::binary | std::ios::ate);
+        if (fin.fail()) return false;
+
+        size_t size = static_cast<size_t>(fin.tellg());
+        char *buf = new char[(size > 0) ? size : 1];
+
+        fin.seekg(0, std::ios::beg);
+        if (not fin.read(buf, size))
+        {
+            delete[] buf;
+            return false;
+        }
+
+        m_data = buf;
+        m_size = size;
+        m_is_mapped = false;
+        return true;
+    }
+
+#ifndef _WIN32
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // AN EMPTY FILE CANNOT BE MAPPED, SO A DUMMY BLOCK IS USED INSTEAD.
+    if (st.st_size == 0)
+    {
+        ::close(fd);
+        m_data = new char[1];
+        m_size = 0;
+        m_is_mapped = false;
+        return true;
+    }
+
+    void *p = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (p == MAP_FAILED) return false;
+
+    m_data = static_cast<const char*>(p);
+    m_size = st.st_size;
+    m_is_mapped = true;
+
+    return true;
+#endif
+}
+
+
+void mapped_file_t::close()
+{
+    if (m_data == NULL) return;
+
+#ifdef _WIN32
+    delete[] m_data;
+#else
+    if (m_is_mapped)
+        ::munmap(const_cast<char*>(m_data), m_size);
+    else
+        delete[] m_data;
+#endif
+
+    m_data = NULL;
+    m_size = 0;
+    m_is_mapped = false;
+}
+
+
+external_sorter_t::~external_sorter_t()
+{
+    for (const auto &path : m_runs)
+        std::remove(path.c_str());
+}
+
+
+void external_sorter_t::write_run(std::vector<record_t> *records)
+{
+    if (records->empty()) return;
+
+    std::sort(records->begin(), records->end());
+    records->erase(std::unique(records->begin(), records->end()), records->end());
+
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        path = format("%s.%d.tmp", m_prefix.c_str(), (int)m_runs.size());
+        m_runs.push_back(path);
+    }
+
+    std::ofstream fo(path.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (not fo)
+        throw phillip_exception_t("Cannot open the file: " + path);
+
+    for (const auto &r : (*records))
+    {
+        uint32_t ksize(r.first.size()), vsize(r.second.size());
+        fo.write((const char*)&ksize, sizeof(uint32_t));
+        fo.write(r.first.data(), ksize);
+        fo.write((const char*)&vsize, sizeof(uint32_t));
+        fo.write(r.second.data(), vsize);
+
+        if (not fo)
+            throw phillip_exception_t("Cannot write the file: " + path);
+    }
+
+    fo.close();
+    if (fo.fail())
+        throw phillip_exception_t("Cannot write the file: " + path);
+
+    records->clear();
+}
+
+
+void external_sorter_t::merge(const std::function<
+    void(const std::string&, const std::vector<std::string>&)> &f) const
+{
+    std::vector<std::unique_ptr<std::ifstream> > runs;
+    std::vector<record_t> heads(m_runs.size());
+
+    auto read = [&](size_t i) -> bool
+    {
+        std::ifstream &fi = *runs.at(i);
+        uint32_t size;
+
+        // THE RUN ENDS ONLY AT A BOUNDARY OF RECORDS.
+        if (not fi.read((char*)&size, sizeof(uint32_t)))
+        {
+            if (fi.gcount() == 0 and fi.eof()) return false;
+            throw phillip_exception_t("Cannot read the file: " + m_runs.at(i));
+        }
+
+        heads[i].first.resize(size);
+        if (size > 0) fi.read(&heads[i].first[0], size);
+
+        fi.read((char*)&size, sizeof(uint32_t));
+        if (fi)
+        {
+            heads[i].second.resize(size);
+            if (size > 0) fi.read(&heads[i].second[0], size);
+        }
+
+        if (not fi)
+            throw phillip_exception_t("Cannot read the file: " + m_runs.at(i));
+        return true;
+    };
+
+    /* THE HEAD OF EACH RUN IS IN THE QUEUE, WHICH POPS THE SMALLEST ONE FIRST. */
+    auto greater = [&heads](size_t i, size_t j) { return heads[i] > heads[j]; };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> queue(greater);
+
+    for (size_t i = 0; i < m_runs.size(); ++i)
+    {
+        runs.emplace_back(new std::ifstream(m_runs[i].c_str(), std::ios::in | std::ios::binary));
+        if (not (*runs.back()))
+            throw phillip_exception_t("Cannot open the file: " + m_runs[i]);
+        if (read(i)) queue.push(i);
+    }
+
+    std::string key;
+    std::vector<std::string> values;
+
+    while (not queue.empty())
+    {
+        size_t i = queue.top();
+        queue.pop();
+
+        if (values.empty() or heads[i].first != key)
+        {
+            if (not values.empty()) f(key, values);
+            key = heads[i].first;
+            values.clear();
+        }
+
+        if (values.empty() or values.back() != heads[i].second)
+            values.push_back(heads[i].second);
+
+        if (read(i)) queue.push(i);
+    }
+
+    if (not values.empty()) f(key, values);
 }
 
 
@@ -434,11 +761,6 @@ std::string time_stamp()
         "# %02d/%02d/%04d %02d:%02d:%02d | ",
         month, day, year, hour, min, sec);
 #else
-    time_t t;
-    tm *p_ltm;
-    time(&t);
-    p_ltm = localtime(&t);
-
     return format(
         "\33[0;34m# %02d/%02d/%04d %02d:%02d:%02d\33[0m] ",
         month, day, year, hour, min, sec);
@@ -14,10 +14,13 @@
 #include <initializer_list>
 #include <vector>
 #include <list>
+#include <deque>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <exception>
 
@@ -67,6 +70,9 @@ typedef std::tuple<
 typedef std::pair<std::pair<kb::arity_id_t, term_idx_t>,
                   std::pair<kb::arity_id_t, term_idx_t> > hard_term_pair_t;
 
+/** The id of an arity pattern interned in knowledge_base_t. */
+typedef unsigned int pattern_id_t;
+
 inline const std::vector<arity_id_t>&
 arities(const arity_pattern_t &p) { return std::get<0>(p); }
 
@@ -109,6 +115,10 @@ public:
     static inline string_hash_t get_unknown_hash();
     static inline void reset_unknown_hash_count();
 
+    /** Returns whether a term of given name is a hard term.
+     *  Use this instead of is_hard_term() to avoid hashing the name. */
+    static inline bool is_hard_term_name(const std::string &str);
+
     inline string_hash_t();
     inline string_hash_t(const string_hash_t& h);
     inline string_hash_t(const std::string& s);
@@ -138,7 +148,7 @@ private:
 
     static std::mutex ms_mutex_hash, ms_mutex_unknown;
     static hash_map<std::string, unsigned> ms_hashier;
-    static std::vector<std::string> ms_strs;
+    static std::deque<std::string> ms_strs; /// Never moves the elements on growing.
     static unsigned ms_issued_variable_count;
 
     inline void set_flags(const std::string &str);
@@ -263,15 +273,79 @@ std::ostream& operator<<(std::ostream& os, const literal_t& t);
 namespace util
 {
 
+/** A class of read-only file mapped on memory.
+ *  On platforms without mmap, the whole file is read into heap instead. */
+class mapped_file_t
+{
+public:
+    mapped_file_t() : m_data(NULL), m_size(0), m_is_mapped(false) {}
+    ~mapped_file_t() { close(); }
+
+    /** Opens given file. Returns false if it failed.
+     *  @param do_map If false, the file is read on heap instead of being mapped. */
+    bool open(const std::string &filename, bool do_map = true);
+    void close();
+
+    inline const char* data() const { return m_data; }
+    inline size_t size() const { return m_size; }
+    inline bool is_open() const { return m_data != NULL; }
+
+    /** Returns whether the file is actually mapped on memory. */
+    inline bool is_mapped() const { return m_is_mapped; }
+
+private:
+    mapped_file_t(const mapped_file_t&);
+    mapped_file_t& operator=(const mapped_file_t&);
+
+    const char *m_data;
+    size_t m_size;
+    bool m_is_mapped;
+};
+
+
+/** An input stream which reads a memory block without copying it. */
+class memory_istream_t : public std::istream
+{
+public:
+    memory_istream_t(const char *data, size_t size);
+
+private:
+    class buffer_t : public std::streambuf
+    {
+    public:
+        buffer_t(const char *data, size_t size);
+
+    protected:
+        virtual pos_type seekoff(
+            off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override;
+        virtual pos_type seekpos(
+            pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+    };
+
+    buffer_t m_buffer;
+};
+
+
 /** A wrapper class of cdb++. */
 class cdb_data_t
 {
 public:
+    /** Sets whether databases are mapped on memory in query-mode.
+     *  Mapped databases share the page cache among processes. */
+    static void enable_mmap() { ms_do_use_mmap = true; }
+    static void disable_mmap() { ms_do_use_mmap = false; }
+    static bool do_use_mmap() { return ms_do_use_mmap; }
+
     cdb_data_t(std::string filename);
     ~cdb_data_t();
 
     void prepare_compile();
     void prepare_query();
+
+    /** Prepares for reading the database on given memory block.
+     *  The block must be kept until this is finalized. */
+    void prepare_query(const void *data, size_t size);
     void finalize();
 
     inline void put(
@@ -285,9 +359,12 @@ public:
     inline bool is_readable() const { return m_finder != NULL; }
 
 private:
+    static bool ms_do_use_mmap;
+
     std::string m_filename;
     std::ofstream  *m_fout;
     std::ifstream  *m_fin;
+    mapped_file_t  *m_map;
     cdbpp::builder *m_builder;
     cdbpp::cdbpp   *m_finder;
 };
@@ -311,6 +388,52 @@ private:
 };
 
 
+/** A token to stop long computations for an observation cooperatively.
+ *  Computations poll the token in their loops and stop when it is cancelled.
+ *  A token is stopped until the next stage when its deadline has passed
+ *  or stop() is called, and is cancelled until reset() when cancel() is called.
+ *  poll() reads the clock only once in POLL_INTERVAL calls,
+ *  so that it can be called in hot loops. */
+class cancellation_token_t
+{
+public:
+    cancellation_token_t();
+
+    /** Clears all of cancellation and the deadline. */
+    void reset();
+
+    /** Starts a new stage whose deadline is given seconds later.
+     *  If timeout is not positive, the stage has no deadline. */
+    void start(duration_time_t timeout);
+
+    /** Stops the current stage. */
+    inline void stop() { m_is_stopped.store(true, std::memory_order_relaxed); }
+
+    /** Stops the current stage and all of following stages. */
+    inline void cancel() { m_is_cancelled.store(true, std::memory_order_relaxed); }
+
+    /** Returns whether the token is stopped, without reading the clock. */
+    inline bool is_cancelled() const;
+
+    /** Returns whether the token is stopped.
+     *  The deadline is checked only once in POLL_INTERVAL calls. */
+    inline bool poll() const;
+
+    /** Returns whether the token is stopped, checking the deadline now. */
+    bool check() const;
+
+    static const unsigned POLL_INTERVAL = 256;
+
+private:
+    bool m_has_deadline;
+    std::chrono::system_clock::time_point m_deadline;
+
+    mutable std::atomic<bool> m_is_stopped;
+    std::atomic<bool> m_is_cancelled;
+    mutable std::atomic<unsigned> m_num_polled;
+};
+
+
 class xml_element_t
 {
 public:
@@ -398,6 +521,224 @@ protected:
 };
 
 
+/** A thread-safe cache which holds at most given number of elements.
+ *  When the cache is full, the least recently used element is discarded. */
+template <class Key, class Value> class lru_cache_t
+{
+public:
+    lru_cache_t(size_t capacity) : m_capacity(capacity) {}
+
+    /** Copies the value corresponding to given key to out.
+     *  Returns false if the key is not cached. */
+    bool get(const Key &key, Value *out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_map.find(key);
+        if (found == m_map.end()) return false;
+
+        m_list.splice(m_list.begin(), m_list, found->second);
+        (*out) = found->second->second;
+        return true;
+    }
+
+    void put(const Key &key, const Value &value)
+    {
+        if (m_capacity == 0) return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_map.find(key);
+        if (found != m_map.end())
+        {
+            found->second->second = value;
+            m_list.splice(m_list.begin(), m_list, found->second);
+            return;
+        }
+
+        m_list.push_front(std::make_pair(key, value));
+        m_map[key] = m_list.begin();
+
+        while (m_map.size() > m_capacity)
+        {
+            m_map.erase(m_list.back().first);
+            m_list.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_map.clear();
+        m_list.clear();
+    }
+
+    inline size_t capacity() const { return m_capacity; }
+
+private:
+    typedef std::list<std::pair<Key, Value> > list_t;
+
+    size_t m_capacity;
+    list_t m_list;
+    hash_map<Key, typename list_t::iterator> m_map;
+    std::mutex m_mutex;
+};
+
+
+/** A thread-safe FIFO queue which holds at most given number of elements.
+ *  Producers are blocked while the queue is full,
+ *  and consumers are blocked while the queue is empty. */
+template <class T> class bounded_queue_t
+{
+public:
+    bounded_queue_t(size_t capacity)
+        : m_capacity(capacity > 0 ? capacity : 1), m_is_closed(false) {}
+
+    /** Adds an element to the tail.
+     *  Returns false if the queue has been closed. */
+    bool push(const T &x)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_space.wait(lock, [this]()
+        { return m_is_closed or m_queue.size() < m_capacity; });
+
+        if (m_is_closed) return false;
+
+        m_queue.push_back(x);
+        m_cond_data.notify_one();
+        return true;
+    }
+
+    /** Moves the element on the head to out.
+     *  Returns false if the queue has been closed and is empty. */
+    bool pop(T *out)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_data.wait(lock, [this]()
+        { return m_is_closed or not m_queue.empty(); });
+
+        if (m_queue.empty()) return false;
+
+        (*out) = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_cond_space.notify_one();
+        return true;
+    }
+
+    /** Stops accepting elements.
+     *  Elements which have been pushed still can be popped. */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_closed = true;
+        m_cond_space.notify_all();
+        m_cond_data.notify_all();
+    }
+
+    inline size_t capacity() const { return m_capacity; }
+
+private:
+    size_t m_capacity;
+    bool m_is_closed;
+    std::deque<T> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_space, m_cond_data;
+};
+
+
+/** A thread-safe pool of objects which are expensive to create.
+ *  Objects are created on demand and are kept after use,
+ *  so that only as many objects as are used at once are created. */
+template <class T> class object_pool_t
+{
+public:
+    /** A handle of an object taken from a pool,
+     *  which returns the object to the pool on destruction. */
+    class lease_t
+    {
+    public:
+        lease_t(object_pool_t<T> *pool) : m_pool(pool), m_ptr(pool->acquire()) {}
+        ~lease_t() { m_pool->release(m_ptr); }
+
+        inline T* get() const { return m_ptr; }
+        inline T* operator->() const { return m_ptr; }
+        inline T& operator*() const { return *m_ptr; }
+
+    private:
+        lease_t(const lease_t&);
+        lease_t& operator=(const lease_t&);
+
+        object_pool_t<T> *m_pool;
+        T *m_ptr;
+    };
+
+    /** @param create A function to create a new object. */
+    object_pool_t(const std::function<T*()> &create) : m_create(create) {}
+    ~object_pool_t()
+    {
+        for (auto p : m_idle) delete p;
+    }
+
+    /** Takes an idle object, or creates new one if there is no idle one. */
+    T* acquire()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (not m_idle.empty())
+            {
+                T *out = m_idle.back();
+                m_idle.pop_back();
+                return out;
+            }
+        }
+        return m_create();
+    }
+
+    /** Returns an object taken by acquire(). */
+    void release(T *p)
+    {
+        if (p == NULL) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(p);
+    }
+
+private:
+    std::function<T*()> m_create;
+    std::vector<T*> m_idle;
+    std::mutex m_mutex;
+};
+
+
+/** A sorter of pairs of byte-strings, whose memory usage is bounded.
+ *  Records are sorted in memory chunk by chunk and are spilled to run-files,
+ *  which are merged on reading. Run-files are removed on destruction. */
+class external_sorter_t
+{
+public:
+    typedef std::pair<std::string, std::string> record_t;
+
+    /** @param prefix The prefix of paths of run-files. */
+    external_sorter_t(const std::string &prefix) : m_prefix(prefix) {}
+    ~external_sorter_t();
+
+    /** Sorts given records and writes them as a new run-file.
+     *  Records are cleared after writing. This method is thread-safe.
+     *  Throws phillip_exception_t if the run-file cannot be written. */
+    void write_run(std::vector<record_t> *records);
+
+    /** Merges all run-files and calls f for each key
+     *  with its distinct values in ascending order.
+     *  Throws phillip_exception_t if a run-file is unreadable or truncated. */
+    void merge(const std::function<
+        void(const std::string&, const std::vector<std::string>&)> &f) const;
+
+    inline size_t num_runs() const { return m_runs.size(); }
+
+private:
+    std::string m_prefix;
+    std::vector<std::string> m_runs;
+    std::mutex m_mutex;
+};
+
+
 /** A template class of list to be used as a key of std::map. */
 template <class T> class comparable_list : public std::list<T>
 {
@@ -419,6 +760,24 @@ public:
 };
 
 
+/** A read-only view of an array, which does not own the elements. */
+template <class T> class array_view_t
+{
+public:
+    array_view_t() : m_begin(NULL), m_end(NULL) {}
+    array_view_t(const T *begin, const T *end) : m_begin(begin), m_end(end) {}
+
+    inline const T* begin() const { return m_begin; }
+    inline const T* end() const { return m_end; }
+    inline const T& operator[](size_t i) const { return m_begin[i]; }
+    inline size_t size() const { return m_end - m_begin; }
+    inline bool empty() const { return m_begin == m_end; }
+
+private:
+    const T *m_begin, *m_end;
+};
+
+
 /** This class is used to define a singleton class. */
 template <class T> class deleter_t
 {
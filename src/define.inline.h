@@ -145,6 +145,16 @@ inline bool string_hash_t::operator != (const string_hash_t &h) const
 }
 
 
+inline bool string_hash_t::is_hard_term_name(const std::string &str)
+{
+#ifdef DISABLE_HARD_TERM
+    return false;
+#else
+    return (not str.empty()) and (str.front() == '*');
+#endif
+}
+
+
 inline void string_hash_t::set_flags(const std::string &str)
 {
     assert(not str.empty());
@@ -153,11 +163,7 @@ inline void string_hash_t::set_flags(const std::string &str)
         m_is_constant = std::isupper(str.at(0));
         m_is_unknown = (str.size() < 2) ? false :
             (str.at(0) == '_' and str.at(1) == 'u');
-#ifdef DISABLE_HARD_TERM
-        m_is_hard_term = false;
-#else        
-        m_is_hard_term = str.empty() ? false : (str.front() == '*');
-#endif
+        m_is_hard_term = is_hard_term_name(str);
     }
     else
     {
@@ -276,6 +282,23 @@ inline bool timeout_t::do_time_out(const std::chrono::system_clock::time_point &
 }
 
 
+inline bool cancellation_token_t::is_cancelled() const
+{
+    return
+        m_is_stopped.load(std::memory_order_relaxed) or
+        m_is_cancelled.load(std::memory_order_relaxed);
+}
+
+
+inline bool cancellation_token_t::poll() const
+{
+    if (m_num_polled.fetch_add(1, std::memory_order_relaxed) % POLL_INTERVAL == 0)
+        return check();
+    else
+        return is_cancelled();
+}
+
+
 
 inline void cdb_data_t::put(
     const void *key, size_t ksize, const void *value, size_t vsize)
@@ -365,16 +388,16 @@ inline void now(int *year, int *month, int *day, int *hour, int *min, int *sec)
     *sec = ltm.tm_sec;
 #else
     time_t t;
-    tm *p_ltm;
+    struct tm ltm;
     time(&t);
-    p_ltm = localtime(&t);
-
-    *year = 1900 + p_ltm->tm_year;
-    *month = 1 + p_ltm->tm_mon;
-    *day = p_ltm->tm_mday;
-    *hour = p_ltm->tm_hour;
-    *min = p_ltm->tm_min;
-    *sec = p_ltm->tm_sec;
+    localtime_r(&t, &ltm);
+
+    *year = 1900 + ltm.tm_year;
+    *month = 1 + ltm.tm_mon;
+    *day = ltm.tm_mday;
+    *hour = ltm.tm_hour;
+    *min = ltm.tm_min;
+    *sec = ltm.tm_sec;
 #endif
 }
 
@@ -3,6 +3,9 @@
 
 #include <sstream>
 #include <set>
+#include <map>
+#include <cmath>
+#include <algorithm>
 
 #include "./ilp_problem.h"
 #include "./phillip.h"
@@ -53,6 +56,16 @@ void constraint_t::print(
 }
 
 
+ilp_problem_t::ilp_problem_t(
+    const pg::proof_graph_t* lhs, solution_interpreter_t *si, bool do_maximize)
+    : m_do_maximize(do_maximize), m_is_timeout(false), m_max_constraint_num(-1),
+      m_graph(lhs), m_cutoff(INVALID_CUT_OFF), m_solution_interpreter(si)
+{
+    if (phillip() != NULL)
+        m_max_constraint_num = phillip()->param_int("max_constraint_num", -1);
+}
+
+
 ilp_problem_t::~ilp_problem_t()
 {
     delete m_solution_interpreter;
@@ -542,6 +555,13 @@ void ilp_problem_t::add_constraints_of_transitive_unifications()
         for( size_t j = 1; j < i;            ++j )
         for( size_t k = 0; k < j;            ++k )
         {
+            // THE NUMBER OF TRIPLES IS CUBIC IN THE SIZE OF THE CLUSTER.
+            if (do_interrupt())
+            {
+                timeout(true);
+                return;
+            }
+
             add_constraints_of_transitive_unification(
                 terms[i], terms[j], terms[k]);
         }
@@ -549,6 +569,505 @@ void ilp_problem_t::add_constraints_of_transitive_unifications()
 }
 
 
+bool ilp_problem_t::do_interrupt() const
+{
+    phillip_main_t *ph = phillip();
+    if (ph == NULL) return false;
+
+    if (m_max_constraint_num > 0 and
+        m_constraints.size() >= static_cast<size_t>(m_max_constraint_num))
+    {
+        ph->cancellation().stop();
+        return true;
+    }
+
+    return ph->cancellation().poll();
+}
+
+
+void ilp_problem_t::export_constraints(
+    constraint_matrix_t *out, const hash_set<constraint_idx_t> *excluded) const
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    size_t num_vars = m_variables.size();
+
+    // ENTRIES IN ROW-MAJOR ORDER, WHERE DUPLICATED VARIABLES ARE MERGED.
+    std::vector<int> cols;
+    std::vector<double> vals;
+    std::vector<size_t> row_begins(1, 0);
+    std::vector<int> position(num_vars, -1);
+
+    out->rows.clear();
+    out->operators.clear();
+    out->lower_bounds.clear();
+    out->upper_bounds.clear();
+
+    for (constraint_idx_t i = 0; i < m_constraints.size(); ++i)
+    {
+        if (excluded != NULL and excluded->count(i) > 0)
+            continue;
+
+        const constraint_t &con = m_constraints.at(i);
+        size_t begin = cols.size();
+
+        for (const auto &t : con.terms())
+        {
+            int &pos = position[t.var_idx];
+            if (pos < 0)
+            {
+                pos = static_cast<int>(cols.size());
+                cols.push_back(t.var_idx);
+                vals.push_back(t.coefficient);
+            }
+            else
+                vals[pos] += t.coefficient;
+        }
+
+        for (size_t k = begin; k < cols.size(); ++k)
+            position[cols[k]] = -1;
+        row_begins.push_back(cols.size());
+
+        double lower(-inf), upper(inf);
+        switch (con.operator_type())
+        {
+        case OPR_EQUAL:
+            lower = upper = con.bound(); break;
+        case OPR_LESS_EQ:
+            upper = con.upper_bound(); break;
+        case OPR_GREATER_EQ:
+            lower = con.lower_bound(); break;
+        case OPR_RANGE:
+            lower = con.lower_bound();
+            upper = con.upper_bound();
+            break;
+        default: break;
+        }
+
+        out->rows.push_back(i);
+        out->operators.push_back(con.operator_type());
+        out->lower_bounds.push_back(lower);
+        out->upper_bounds.push_back(upper);
+    }
+
+    // CONVERT INTO COLUMN-MAJOR ORDER BY COUNTING SORT.
+    out->column_begins.assign(num_vars + 1, 0);
+    for (auto c : cols)
+        ++out->column_begins[c + 1];
+    for (size_t j = 0; j < num_vars; ++j)
+        out->column_begins[j + 1] += out->column_begins[j];
+
+    out->row_indices.resize(cols.size());
+    out->values.resize(cols.size());
+
+    std::vector<size_t> next(out->column_begins.begin(), out->column_begins.end() - 1);
+    for (size_t r = 0; r + 1 < row_begins.size(); ++r)
+    for (size_t k = row_begins[r]; k < row_begins[r + 1]; ++k)
+    {
+        size_t p = next[cols[k]]++;
+        out->row_indices[p] = static_cast<int>(r);
+        out->values[p] = vals[k];
+    }
+}
+
+
+const double PRESOLVE_EPS = 1e-9;
+
+
+void presolver_t::presolve(
+    const ilp_problem_t *prob, const hash_set<constraint_idx_t> *excluded,
+    bool do_reduce)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    size_t num_vars = prob->variables().size();
+
+    m_do_reduce = do_reduce;
+    m_lb.assign(num_vars, 0.0);
+    m_ub.assign(num_vars, 1.0);
+    m_obj.resize(num_vars);
+    m_rep.resize(num_vars);
+    m_position.assign(num_vars, -1);
+
+    for (variable_idx_t v = 0; v < num_vars; ++v)
+    {
+        if (prob->is_constant_variable(v))
+            m_lb[v] = m_ub[v] = prob->const_variable_value(v);
+        m_obj[v] = prob->variable(v).objective_coefficient();
+        m_rep[v] = v;
+    }
+
+    m_rows.clear();
+    for (constraint_idx_t i = 0; i < prob->constraints().size(); ++i)
+    {
+        if (excluded != NULL and excluded->count(i) > 0)
+            continue;
+
+        const constraint_t &con = prob->constraint(i);
+        row_t row;
+        row.index = i;
+        row.is_alive = true;
+        row.lower = -inf;
+        row.upper = inf;
+
+        switch (con.operator_type())
+        {
+        case OPR_EQUAL:
+            row.lower = row.upper = con.bound(); break;
+        case OPR_LESS_EQ:
+            row.upper = con.upper_bound(); break;
+        case OPR_GREATER_EQ:
+            row.lower = con.lower_bound(); break;
+        case OPR_RANGE:
+            row.lower = con.lower_bound();
+            row.upper = con.upper_bound();
+            break;
+        default: break;
+        }
+
+        for (const auto &t : con.terms())
+            row.terms.push_back(std::make_pair(t.var_idx, t.coefficient));
+
+        m_rows.push_back(row);
+    }
+
+    if (m_do_reduce)
+    {
+        bool is_feasible(true);
+
+        for (int pass = 0; pass < MAX_PASS_NUM and is_feasible; ++pass)
+        {
+            bool changed(false);
+
+            for (auto &row : m_rows)
+            if (row.is_alive)
+            {
+                if (not examine(&row, &changed))
+                {
+                    is_feasible = false;
+                    break;
+                }
+            }
+
+            if (is_feasible and merge_parallel_rows())
+                changed = true;
+
+            if (not changed) break;
+        }
+
+        if (not is_feasible)
+        {
+            IF_VERBOSE_3("Presolve: The problem is infeasible and is passed as it is.");
+            presolve(prob, excluded, false);
+            return;
+        }
+    }
+
+    build();
+
+    IF_VERBOSE_3(util::format(
+        "Presolve: %d variables -> %d columns, %d constraints -> %d rows",
+        (int)num_vars, (int)m_columns.size(),
+        (int)prob->constraints().size(), (int)m_matrix.num_rows()));
+}
+
+
+variable_idx_t presolver_t::find(variable_idx_t v) const
+{
+    while (m_rep[v] != v)
+    {
+        m_rep[v] = m_rep[m_rep[v]];
+        v = m_rep[v];
+    }
+    return v;
+}
+
+
+void presolver_t::normalize(
+    std::vector<std::pair<variable_idx_t, double> > *terms,
+    double *lower, double *upper) const
+{
+    std::vector<std::pair<variable_idx_t, double> > out;
+
+    for (const auto &t : *terms)
+    {
+        variable_idx_t v = m_do_reduce ? find(t.first) : t.first;
+
+        if (m_do_reduce and is_fixed(v))
+        {
+            double d = t.second * m_lb[v];
+            *lower -= d;
+            *upper -= d;
+            continue;
+        }
+
+        int &pos = m_position[v];
+        if (pos < 0)
+        {
+            pos = static_cast<int>(out.size());
+            out.push_back(std::make_pair(v, t.second));
+        }
+        else
+            out[pos].second += t.second;
+    }
+
+    for (const auto &t : out)
+        m_position[t.first] = -1;
+
+    out.erase(std::remove_if(out.begin(), out.end(),
+        [](const std::pair<variable_idx_t, double> &t)
+    { return std::abs(t.second) < PRESOLVE_EPS; }), out.end());
+    std::sort(out.begin(), out.end());
+
+    terms->swap(out);
+}
+
+
+bool presolver_t::examine(row_t *row, bool *changed)
+{
+    const double eps = PRESOLVE_EPS;
+    auto &terms = row->terms;
+
+    normalize(&terms, &row->lower, &row->upper);
+
+    auto kill = [&]()
+    {
+        row->is_alive = false;
+        *changed = true;
+        return true;
+    };
+
+    if (terms.empty())
+        return (row->lower <= eps and row->upper >= -eps) ? kill() : false;
+
+    double act_min(0.0), act_max(0.0);
+    for (const auto &t : terms)
+    {
+        double a(t.second), lb(m_lb[t.first]), ub(m_ub[t.first]);
+        act_min += (a > 0.0) ? a * lb : a * ub;
+        act_max += (a > 0.0) ? a * ub : a * lb;
+    }
+
+    if (act_max < row->lower - eps or act_min > row->upper + eps)
+        return false;
+
+    // THE ROW IS ALWAYS SATISFIED.
+    if (act_min >= row->lower - eps and act_max <= row->upper + eps)
+        return kill();
+
+    // A SINGLETON ROW IS A BOUND OF THE VARIABLE.
+    // ALL VARIABLES ARE INTEGERS, SO THAT BOUNDS ARE ROUNDED.
+    if (terms.size() == 1)
+    {
+        variable_idx_t v(terms[0].first);
+        double a(terms[0].second);
+        double lo = (a > 0.0) ? row->lower / a : row->upper / a;
+        double up = (a > 0.0) ? row->upper / a : row->lower / a;
+
+        m_lb[v] = std::max(m_lb[v], std::ceil(lo - eps));
+        m_ub[v] = std::min(m_ub[v], std::floor(up + eps));
+
+        return (m_lb[v] <= m_ub[v]) ? kill() : false;
+    }
+
+    // A FORCING ROW CAN BE SATISFIED ONLY BY ONE EXTREME OF ITS ACTIVITY.
+    bool is_forcing_max = (act_max <= row->lower + eps);
+    bool is_forcing_min = (act_min >= row->upper - eps);
+    if (is_forcing_max or is_forcing_min)
+    {
+        for (const auto &t : terms)
+        {
+            variable_idx_t v(t.first);
+            bool to_upper = ((t.second > 0.0) == is_forcing_max);
+            if (to_upper) m_lb[v] = m_ub[v];
+            else          m_ub[v] = m_lb[v];
+        }
+        return kill();
+    }
+
+    // "a * x - a * y = 0" MEANS THAT x AND y ARE EQUIVALENT.
+    if (terms.size() == 2 and
+        std::abs(row->lower) < eps and std::abs(row->upper) < eps and
+        std::abs(terms[0].second + terms[1].second) < eps)
+    {
+        variable_idx_t x(terms[0].first), y(terms[1].first);
+
+        m_rep[y] = x;
+        m_lb[x] = std::max(m_lb[x], m_lb[y]);
+        m_ub[x] = std::min(m_ub[x], m_ub[y]);
+        m_obj[x] += m_obj[y];
+        m_obj[y] = 0.0;
+
+        return (m_lb[x] <= m_ub[x]) ? kill() : false;
+    }
+
+    return true;
+}
+
+
+bool presolver_t::merge_parallel_rows()
+{
+    // ROWS ARE SCALED SO THAT THE FIRST COEFFICIENT IS ONE.
+    std::map<std::vector<std::pair<variable_idx_t, double> >, size_t> found;
+    bool changed(false);
+
+    for (size_t i = 0; i < m_rows.size(); ++i)
+    {
+        row_t &row = m_rows[i];
+        if (not row.is_alive or row.terms.empty()) continue;
+
+        double scale = 1.0 / row.terms.front().second;
+        std::vector<std::pair<variable_idx_t, double> > key(row.terms);
+        for (auto &t : key) t.second *= scale;
+
+        auto it = found.find(key);
+        if (it == found.end())
+        {
+            found[key] = i;
+            continue;
+        }
+
+        // THE BOUNDS OF THIS ROW ARE CONVERTED INTO THE SCALE OF THE FORMER ONE.
+        row_t &former = m_rows[it->second];
+        double ratio = former.terms.front().second / row.terms.front().second;
+        double lo(row.lower * ratio), up(row.upper * ratio);
+        if (ratio < 0.0) std::swap(lo, up);
+
+        former.lower = std::max(former.lower, lo);
+        former.upper = std::min(former.upper, up);
+        row.is_alive = false;
+        changed = true;
+    }
+
+    return changed;
+}
+
+
+void presolver_t::build()
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    size_t num_vars = m_lb.size();
+
+    m_columns.clear();
+    m_column_of.assign(num_vars, -1);
+    for (variable_idx_t v = 0; v < num_vars; ++v)
+    {
+        if (m_do_reduce and (find(v) != v or is_fixed(v)))
+            continue;
+        m_column_of[v] = static_cast<int>(m_columns.size());
+        m_columns.push_back(v);
+    }
+
+    m_alive_rows.clear();
+    m_matrix.rows.clear();
+    m_matrix.operators.clear();
+    m_matrix.lower_bounds.clear();
+    m_matrix.upper_bounds.clear();
+
+    std::vector<size_t> counts(m_columns.size() + 1, 0);
+
+    for (size_t i = 0; i < m_rows.size(); ++i)
+    {
+        row_t &row = m_rows[i];
+        if (not row.is_alive) continue;
+
+        normalize(&row.terms, &row.lower, &row.upper);
+        for (const auto &t : row.terms)
+            ++counts[m_column_of[t.first] + 1];
+
+        constraint_operator_e opr =
+            (row.lower == row.upper) ? OPR_EQUAL :
+            (row.lower > -inf and row.upper < inf) ? OPR_RANGE :
+            (row.lower > -inf) ? OPR_GREATER_EQ : OPR_LESS_EQ;
+
+        m_alive_rows.push_back(i);
+        m_matrix.rows.push_back(row.index);
+        m_matrix.operators.push_back(opr);
+        m_matrix.lower_bounds.push_back(row.lower);
+        m_matrix.upper_bounds.push_back(row.upper);
+    }
+
+    for (size_t j = 0; j < m_columns.size(); ++j)
+        counts[j + 1] += counts[j];
+    m_matrix.column_begins = counts;
+    m_matrix.row_indices.resize(counts.back());
+    m_matrix.values.resize(counts.back());
+
+    for (size_t r = 0; r < m_alive_rows.size(); ++r)
+    for (const auto &t : m_rows[m_alive_rows[r]].terms)
+    {
+        size_t p = counts[m_column_of[t.first]]++;
+        m_matrix.row_indices[p] = static_cast<int>(r);
+        m_matrix.values[p] = t.second;
+    }
+}
+
+
+void presolver_t::get_row(
+    size_t r, std::vector<int> *cols, std::vector<double> *coefs) const
+{
+    cols->clear();
+    coefs->clear();
+
+    for (const auto &t : m_rows.at(m_alive_rows.at(r)).terms)
+    {
+        cols->push_back(m_column_of[t.first]);
+        coefs->push_back(t.second);
+    }
+}
+
+
+void presolver_t::reduce(
+    const constraint_t &con, std::vector<int> *cols, std::vector<double> *coefs,
+    double *lower, double *upper) const
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    std::vector<std::pair<variable_idx_t, double> > terms;
+
+    for (const auto &t : con.terms())
+        terms.push_back(std::make_pair(t.var_idx, t.coefficient));
+
+    *lower = -inf;
+    *upper = inf;
+    switch (con.operator_type())
+    {
+    case OPR_EQUAL:
+        *lower = *upper = con.bound(); break;
+    case OPR_LESS_EQ:
+        *upper = con.upper_bound(); break;
+    case OPR_GREATER_EQ:
+        *lower = con.lower_bound(); break;
+    case OPR_RANGE:
+        *lower = con.lower_bound();
+        *upper = con.upper_bound();
+        break;
+    default: break;
+    }
+
+    normalize(&terms, lower, upper);
+
+    cols->clear();
+    coefs->clear();
+    for (const auto &t : terms)
+    {
+        cols->push_back(m_column_of[t.first]);
+        coefs->push_back(t.second);
+    }
+}
+
+
+void presolver_t::restore(
+    const std::vector<double> &values, std::vector<double> *out) const
+{
+    out->resize(m_lb.size());
+
+    for (variable_idx_t v = 0; v < m_lb.size(); ++v)
+    {
+        variable_idx_t r = m_do_reduce ? find(v) : v;
+        int j = m_column_of[r];
+        (*out)[v] = (j >= 0) ? values.at(j) : m_lb[r];
+    }
+}
+
+
 void ilp_problem_t::enumerate_variables_for_requirement(
     const pg::requirement_t::element_t &req, hash_set<variable_idx_t> *out) const
 {
@@ -846,14 +1365,14 @@ void ilp_problem_t::print_solution(
         << "<proofgraph name=\"" << name()
         << "\" state=\"" << state
         << "\" objective=\"" << sol->value_of_objective_function()
-        << "\">" << std::endl;
+        << "\">\n";
 
     (*os)
         << "<time lhs=\"" << phillip()->get_time_for_lhs()
         << "\" ilp=\"" << phillip()->get_time_for_ilp()
         << "\" sol=\"" << phillip()->get_time_for_sol()
         << "\" all=\"" << phillip()->get_time_for_infer()
-        << "\"></time>" << std::endl;
+        << "\"></time>\n";
 
     const ilp::ilp_problem_t *prob(sol->problem());
     const pg::proof_graph_t *graph(sol->problem()->proof_graph());
@@ -864,15 +1383,18 @@ void ilp_problem_t::print_solution(
         << "\" ilp=\"" << (prob->has_timed_out() ? "yes" : "no")
         << "\" sol=\"" << (sol->has_timed_out() ? "yes" : "no")
         << "\" all=\"" << (is_time_out_all ? "yes" : "no")
-        << "\"></timeout>" << std::endl;
+        << "\"></timeout>\n";
 
     if (phillip()->flag("human_readable_output"))
         sol->print_human_readable_hypothesis(os);
 
+    /* IN COMPACT MODE, INACTIVE LITERALS AND EDGES ARE NOT PRINTED. */
+    bool is_compact = phillip()->flag("compact_output");
+
     _print_requirements_in_solution(sol, os);
-    _print_literals_in_solution(sol, os);
-    _print_explanations_in_solution(sol, os);
-    _print_unifications_in_solution(sol, os);
+    _print_literals_in_solution(sol, os, is_compact);
+    _print_explanations_in_solution(sol, os, is_compact);
+    _print_unifications_in_solution(sol, os, is_compact);
     
     (*os) << "</proofgraph>" << std::endl;
 
@@ -889,7 +1411,7 @@ void ilp_problem_t::_print_requirements_in_solution(
     const std::string LABEL = is_labeling_task ? "label" : "requirement";
 
     if (is_labeling_task)
-        (*os) << "<requirements num=\"" << reqs.size() << "\">" << std::endl;
+        (*os) << "<requirements num=\"" << reqs.size() << "\">\n";
 
     for (auto req : reqs)
     {
@@ -912,43 +1434,50 @@ void ilp_problem_t::_print_requirements_in_solution(
         if (is_labeling_task)
             (*os) << "\" gold=\"" << (req.is_gold ? "yes" : "no");
 
-        (*os) << "\">" << std::endl;
+        (*os) << "\">\n";
 
         for (auto s : sat)
         {
             (*os)
                 << "<literal satisfied=\"" << (s.second ? "yes" : "no")
                 << "\">" << s.first.to_string()
-                << "</literal>" << std::endl;
+                << "</literal>\n";
         }
 
-        (*os) << "</" << LABEL << ">" << std::endl;
+        (*os) << "</" << LABEL << ">\n";
     }
 
     if (is_labeling_task)
-        (*os) << "</requirements>" << std::endl;
+        (*os) << "</requirements>\n";
 }
 
 
 void ilp_problem_t::_print_literals_in_solution(
-    const ilp_solution_t *sol, std::ostream *os) const
+    const ilp_solution_t *sol, std::ostream *os, bool is_compact) const
 {
-    std::list<pg::node_idx_t> indices;
-    for (int i = 0; i < m_graph->nodes().size(); ++i)
+    auto is_printed = [&](pg::node_idx_t i) -> bool
     {
         const pg::node_t &node = m_graph->node(i);
-        if (not node.is_equality_node() and not node.is_non_equality_node())
-            indices.push_back(i);
-    }
+        if (node.is_equality_node() or node.is_non_equality_node())
+            return false;
+        return (not is_compact) or node_is_active(*sol, i);
+    };
+
+    int num(0);
+    for (pg::node_idx_t i = 0; i < m_graph->nodes().size(); ++i)
+        if (is_printed(i)) ++num;
+
+    (*os) << "<literals num=\"" << num << "\">\n";
 
-    (*os) << "<literals num=\"" << indices.size() << "\">" << std::endl;
+    hash_map<std::string, std::string> attributes;
 
-    for (auto it = indices.begin(); it != indices.end(); ++it)
+    for (pg::node_idx_t n_idx = 0; n_idx < m_graph->nodes().size(); ++n_idx)
     {
-        pg::node_idx_t n_idx = (*it);
+        if (not is_printed(n_idx)) continue;
+
         const pg::node_t &node = m_graph->node(n_idx);
         bool is_active = node_is_active(*sol, n_idx);
-        std::string type;
+        const char *type = "";
 
         switch (node.type())
         {
@@ -964,84 +1493,106 @@ void ilp_problem_t::_print_literals_in_solution(
             << "\" depth=\"" << node.depth()
             << "\" active=\"" << (is_active ? "yes" : "no");
 
-        hash_map<std::string, std::string> attributes;
+        attributes.clear();
         for (auto dec = m_xml_decorators.begin(); dec != m_xml_decorators.end(); ++dec)
             (*dec)->get_literal_attributes(sol, n_idx, &attributes);
         for (auto attr = attributes.begin(); attr != attributes.end(); ++attr)
             (*os) << "\" " << attr->first << "=\"" << attr->second;
 
         (*os)
-            << "\">" << node.to_string() << "</literal>" << std::endl;
+            << "\">" << node.to_string() << "</literal>\n";
     }
 
-    (*os) << "</literals>" << std::endl;
+    (*os) << "</literals>\n";
 }
 
 
 void ilp_problem_t::_print_explanations_in_solution(
-    const ilp_solution_t *sol, std::ostream *os) const
+    const ilp_solution_t *sol, std::ostream *os, bool is_compact) const
 {
     const kb::knowledge_base_t *base = kb::knowledge_base_t::instance();
-    std::list<pg::edge_idx_t> indices;
 
-    for (int i = 0; i < m_graph->edges().size(); ++i)
-    if (m_graph->edge(i).is_chain_edge())
-        indices.push_back(i);
+    auto is_printed = [&](pg::edge_idx_t i) -> bool
+    {
+        return m_graph->edge(i).is_chain_edge() and
+            ((not is_compact) or edge_is_active(*sol, i));
+    };
+
+    int num(0);
+    for (pg::edge_idx_t i = 0; i < m_graph->edges().size(); ++i)
+        if (is_printed(i)) ++num;
 
-    (*os) << "<explanations num=\"" << indices.size() << "\">" << std::endl;
+    (*os) << "<explanations num=\"" << num << "\">\n";
 
-    for (auto it = indices.begin(); it != indices.end(); ++it)
+    hash_map<std::string, std::string> attributes;
+    hash_map<axiom_id_t, std::string> axiom_names;
+
+    for (pg::edge_idx_t e_idx = 0; e_idx < m_graph->edges().size(); ++e_idx)
     {
-        const pg::edge_t &edge = m_graph->edge(*it);
-        const std::vector<pg::node_idx_t>
-            &hn_from(m_graph->hypernode(edge.tail())),
-            &hn_to(m_graph->hypernode(edge.head()));
+        if (not is_printed(e_idx)) continue;
+
+        const pg::edge_t &edge = m_graph->edge(e_idx);
         bool is_backward = (edge.type() == pg::EDGE_HYPOTHESIZE);
-        std::string s_from(util::join(hn_from.begin(), hn_from.end(), ","));
-        std::string s_to(util::join(hn_to.begin(), hn_to.end(), ","));
-        std::string axiom_name = base->get_axiom(edge.axiom_id()).name;
-        std::string gaps = util::join_f(
-            m_graph->get_gaps_on_edge(*it),
-            [](const std::pair<arity_t, arity_t> &p){return p.first + ":" + p.second; }, ",");
+
+        auto found = axiom_names.find(edge.axiom_id());
+        if (found == axiom_names.end())
+            found = axiom_names.insert(std::make_pair(
+            edge.axiom_id(), base->get_axiom_view(edge.axiom_id()).name())).first;
 
         (*os)
-            << "<explanation id=\"" << (*it)
+            << "<explanation id=\"" << e_idx
             << "\" tail=\"" << m_graph->hypernode2str(edge.tail())
             << "\" head=\"" << m_graph->hypernode2str(edge.head())
-            << "\" active=\"" << (edge_is_active(*sol, *it) ? "yes" : "no")
+            << "\" active=\"" << (edge_is_active(*sol, e_idx) ? "yes" : "no")
             << "\" backward=\"" << (is_backward ? "yes" : "no")
-            << "\" axiom=\"" << axiom_name
-            << "\" gap=\"" << gaps;
+            << "\" axiom=\"" << found->second
+            << "\" gap=\"";
+        _print_gaps_on_edge(e_idx, os);
 
-        hash_map<std::string, std::string> attributes;
+        attributes.clear();
         for (auto dec = m_xml_decorators.begin(); dec != m_xml_decorators.end(); ++dec)
-            (*dec)->get_explanation_attributes(sol, *it, &attributes);
+            (*dec)->get_explanation_attributes(sol, e_idx, &attributes);
         for (auto attr = attributes.begin(); attr != attributes.end(); ++attr)
             (*os) << "\" " << attr->first << "=\"" << attr->second;
 
         (*os)
-            << "\">" << m_graph->edge_to_string(*it)
-            << "</explanation>" << std::endl;
+            << "\">" << m_graph->edge_to_string(e_idx)
+            << "</explanation>\n";
     }
 
-    (*os) << "</explanations>" << std::endl;
+    (*os) << "</explanations>\n";
 }
 
 
 void ilp_problem_t::_print_unifications_in_solution(
-    const ilp_solution_t *sol, std::ostream *os) const
+    const ilp_solution_t *sol, std::ostream *os, bool is_compact) const
 {
-    std::list<pg::edge_idx_t> indices;
-    for (int i = 0; i < m_graph->edges().size(); ++i)
-    if (m_graph->edge(i).is_unify_edge())
-        indices.push_back(i);
+    auto is_printed = [&](pg::edge_idx_t i) -> bool
+    {
+        return m_graph->edge(i).is_unify_edge() and
+            ((not is_compact) or edge_is_active(*sol, i));
+    };
+
+    int num(0);
+    for (pg::edge_idx_t i = 0; i < m_graph->edges().size(); ++i)
+        if (is_printed(i)) ++num;
+
+    (*os) << "<unifications num=\"" << num << "\">\n";
 
-    (*os) << "<unifications num=\"" << indices.size() << "\">" << std::endl;
+    hash_map<std::string, std::string> attributes;
 
-    for (auto it = indices.begin(); it != indices.end(); ++it)
+    for (pg::edge_idx_t e_idx = 0; e_idx < m_graph->edges().size(); ++e_idx)
     {
-        const pg::edge_t& edge = m_graph->edge(*it);
-        std::vector<std::string> subs;
+        if (not is_printed(e_idx)) continue;
+
+        const pg::edge_t& edge = m_graph->edge(e_idx);
+        const std::vector<pg::node_idx_t>
+            &hn_from(m_graph->hypernode(edge.tail()));
+
+        (*os)
+            << "<unification l1=\"" << hn_from[0]
+            << "\" l2=\"" << hn_from[1]
+            << "\" unifier=\"";
 
         if (edge.head() >= 0)
         {
@@ -1051,37 +1602,336 @@ void ilp_problem_t::_print_unifications_in_solution(
             {
                 const literal_t &lit = m_graph->node(*it).literal();
                 // assert(lit.predicate == "=");
-                subs.push_back(
-                    lit.terms[0].string() + "=" + lit.terms[1].string());
+                if (it != hn_to.begin()) (*os) << ", ";
+                (*os) << lit.terms[0].string() << "=" << lit.terms[1].string();
             }
         }
 
-        const std::vector<pg::node_idx_t>
-            &hn_from(m_graph->hypernode(edge.tail()));
-        std::string gaps = util::join_f(
-            m_graph->get_gaps_on_edge(*it),
-            [](const std::pair<arity_t, arity_t> &p){return p.first + ":" + p.second; }, ",");
-
         (*os)
-            << "<unification l1=\"" << hn_from[0]
-            << "\" l2=\"" << hn_from[1]
-            << "\" unifier=\"" << util::join(subs.begin(), subs.end(), ", ")
-            << "\" active=\"" << (edge_is_active(*sol, *it) ? "yes" : "no")
-            << "\" gap=\"" << gaps;
+            << "\" active=\"" << (edge_is_active(*sol, e_idx) ? "yes" : "no")
+            << "\" gap=\"";
+        _print_gaps_on_edge(e_idx, os);
 
-        hash_map<std::string, std::string> attributes;
+        attributes.clear();
         for (auto dec = m_xml_decorators.begin(); dec != m_xml_decorators.end(); ++dec)
-            (*dec)->get_unification_attributes(sol, *it, &attributes);
+            (*dec)->get_unification_attributes(sol, e_idx, &attributes);
         for (auto attr = attributes.begin(); attr != attributes.end(); ++attr)
             (*os) << "\" " << attr->first << "=\"" << attr->second;
 
         (*os)
             << "\">"
-            << m_graph->edge_to_string(*it)
-            << "</unification>" << std::endl;
+            << m_graph->edge_to_string(e_idx)
+            << "</unification>\n";
+    }
+
+    (*os) << "</unifications>\n";
+}
+
+
+void ilp_problem_t::_print_gaps_on_edge(pg::edge_idx_t idx, std::ostream *os) const
+{
+    auto gaps = m_graph->get_gaps_on_edge(idx);
+
+    for (auto it = gaps.begin(); it != gaps.end(); ++it)
+    {
+        if (it != gaps.begin()) (*os) << ",";
+        (*os) << it->first << ":" << it->second;
+    }
+}
+
+
+/** Writes str to os as a quoted JSON string. */
+static void _print_json_string(const std::string &str, std::ostream *os)
+{
+    (*os) << '"';
+
+    for (auto c : str)
+    {
+        switch (c)
+        {
+        case '"':  (*os) << "\\\""; break;
+        case '\\': (*os) << "\\\\"; break;
+        case '\n': (*os) << "\\n"; break;
+        case '\r': (*os) << "\\r"; break;
+        case '\t': (*os) << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                (*os) << util::format("\\u%04x", static_cast<int>(c));
+            else
+                (*os) << c;
+        }
+    }
+
+    (*os) << '"';
+}
+
+
+static const char* _solution_type_to_str(solution_type_e t)
+{
+    switch (t)
+    {
+    case ilp::SOLUTION_OPTIMAL: return "optimal";
+    case ilp::SOLUTION_SUB_OPTIMAL: return "sub-optimal";
+    case ilp::SOLUTION_NOT_AVAILABLE: return "not-available";
+    default: return "";
+    }
+}
+
+
+static const char* _node_type_to_str(pg::node_type_e t)
+{
+    switch (t)
+    {
+    case pg::NODE_UNDERSPECIFIED: return "underspecified";
+    case pg::NODE_OBSERVABLE:     return "observable";
+    case pg::NODE_HYPOTHESIS:     return "hypothesis";
+    case pg::NODE_REQUIRED:       return "requirement";
+    default: return "";
+    }
+}
+
+
+void ilp_problem_t::print_solution_in_jsonl(
+    const ilp_solution_t *sol, std::ostream *os) const
+{
+    const kb::knowledge_base_t *base = kb::knowledge_base_t::instance();
+    const phillip_main_t *ph = phillip();
+    bool is_time_out_all =
+        m_graph->has_timed_out() or has_timed_out() or sol->has_timed_out();
+
+    auto print_bool = [os](bool b) { (*os) << (b ? "true" : "false"); };
+    auto print_indices = [os](const std::vector<pg::node_idx_t> &hn)
+    {
+        (*os) << '[';
+        for (auto it = hn.begin(); it != hn.end(); ++it)
+            (*os) << (it == hn.begin() ? "" : ",") << (*it);
+        (*os) << ']';
+    };
+
+    (*os) << "{\"name\":";
+    _print_json_string(name(), os);
+    (*os)
+        << ",\"state\":\"" << _solution_type_to_str(sol->type())
+        << "\",\"objective\":" << sol->value_of_objective_function()
+        << ",\"time\":{\"lhs\":" << ph->get_time_for_lhs()
+        << ",\"ilp\":" << ph->get_time_for_ilp()
+        << ",\"sol\":" << ph->get_time_for_sol()
+        << ",\"all\":" << ph->get_time_for_infer()
+        << "},\"timeout\":{\"lhs\":";
+    print_bool(m_graph->has_timed_out());
+    (*os) << ",\"ilp\":";
+    print_bool(has_timed_out());
+    (*os) << ",\"sol\":";
+    print_bool(sol->has_timed_out());
+    (*os) << ",\"all\":";
+    print_bool(is_time_out_all);
+
+    (*os) << "},\"literals\":[";
+    bool is_first(true);
+    for (pg::node_idx_t i = 0; i < m_graph->nodes().size(); ++i)
+    {
+        const pg::node_t &node = m_graph->node(i);
+        if (node.is_equality_node() or node.is_non_equality_node()) continue;
+        if (not node_is_active(*sol, i)) continue;
+
+        (*os)
+            << (is_first ? "" : ",")
+            << "{\"id\":" << i
+            << ",\"type\":\"" << _node_type_to_str(node.type())
+            << "\",\"depth\":" << node.depth()
+            << ",\"literal\":";
+        _print_json_string(node.to_string(), os);
+        (*os) << '}';
+        is_first = false;
+    }
+
+    (*os) << "],\"explanations\":[";
+    is_first = true;
+    for (pg::edge_idx_t i = 0; i < m_graph->edges().size(); ++i)
+    {
+        const pg::edge_t &edge = m_graph->edge(i);
+        if (not edge.is_chain_edge() or not edge_is_active(*sol, i)) continue;
+
+        (*os) << (is_first ? "" : ",") << "{\"id\":" << i << ",\"tail\":";
+        print_indices(m_graph->hypernode(edge.tail()));
+        (*os) << ",\"head\":";
+        print_indices(m_graph->hypernode(edge.head()));
+        (*os) << ",\"backward\":";
+        print_bool(edge.type() == pg::EDGE_HYPOTHESIZE);
+        (*os) << ",\"axiom\":";
+        _print_json_string(base->get_axiom_view(edge.axiom_id()).name(), os);
+        (*os) << '}';
+        is_first = false;
+    }
+
+    (*os) << "],\"unifications\":[";
+    is_first = true;
+    for (pg::edge_idx_t i = 0; i < m_graph->edges().size(); ++i)
+    {
+        const pg::edge_t &edge = m_graph->edge(i);
+        if (not edge.is_unify_edge() or not edge_is_active(*sol, i)) continue;
+
+        const std::vector<pg::node_idx_t> &hn_from(m_graph->hypernode(edge.tail()));
+        (*os)
+            << (is_first ? "" : ",")
+            << "{\"id\":" << i
+            << ",\"l1\":" << hn_from[0]
+            << ",\"l2\":" << hn_from[1]
+            << ",\"unifier\":[";
+
+        if (edge.head() >= 0)
+        {
+            const std::vector<pg::node_idx_t> &hn_to(m_graph->hypernode(edge.head()));
+            for (auto it = hn_to.begin(); it != hn_to.end(); ++it)
+            {
+                const literal_t &lit = m_graph->node(*it).literal();
+                if (it != hn_to.begin()) (*os) << ',';
+                _print_json_string(
+                    lit.terms[0].string() + "=" + lit.terms[1].string(), os);
+            }
+        }
+
+        (*os) << "]}";
+        is_first = false;
     }
 
-    (*os) << "</unifications>" << std::endl;
+    (*os) << "]}\n";
+}
+
+
+const char SOLUTION_BINARY_MAGIC[8] = { 'P', 'H', 'I', 'L', 'S', 'O', 'L', '\0' };
+const uint32_t SOLUTION_BINARY_VERSION = 1;
+
+
+/** A writer to append fixed-size values and strings to a buffer. */
+class binary_record_writer_t
+{
+public:
+    binary_record_writer_t(std::string *buf) : m_buf(buf) {}
+
+    template <class T> void write(const T &value)
+    {
+        m_buf->append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void write(const std::string &str)
+    {
+        write(static_cast<uint32_t>(str.size()));
+        m_buf->append(str);
+    }
+
+    void write(const std::vector<pg::node_idx_t> &indices)
+    {
+        write(static_cast<uint32_t>(indices.size()));
+        for (auto i : indices)
+            write(static_cast<int32_t>(i));
+    }
+
+private:
+    std::string *m_buf;
+};
+
+
+void ilp_problem_t::write_solution_header(std::ostream *os)
+{
+    uint32_t reserved(0);
+    os->write(SOLUTION_BINARY_MAGIC, 8);
+    os->write((const char*)&SOLUTION_BINARY_VERSION, sizeof(uint32_t));
+    os->write((const char*)&reserved, sizeof(uint32_t));
+}
+
+
+void ilp_problem_t::write_solution_in_binary(
+    const ilp_solution_t *sol, std::ostream *os) const
+{
+    /* THE RECORD IS BUILT IN A BUFFER,
+     * SO THAT ITS SIZE CAN BE WRITTEN AT ITS HEAD. */
+    std::string buf;
+    binary_record_writer_t wr(&buf);
+
+    const kb::knowledge_base_t *base = kb::knowledge_base_t::instance();
+    const phillip_main_t *ph = phillip();
+    uint8_t timeouts =
+        (m_graph->has_timed_out() ? 0x01 : 0) |
+        (has_timed_out() ? 0x02 : 0) |
+        (sol->has_timed_out() ? 0x04 : 0);
+
+    wr.write(name());
+    wr.write(static_cast<uint8_t>(sol->type()));
+    wr.write(static_cast<double>(sol->value_of_objective_function()));
+    wr.write(static_cast<float>(ph->get_time_for_lhs()));
+    wr.write(static_cast<float>(ph->get_time_for_ilp()));
+    wr.write(static_cast<float>(ph->get_time_for_sol()));
+    wr.write(static_cast<float>(ph->get_time_for_infer()));
+    wr.write(timeouts);
+
+    std::vector<pg::node_idx_t> literals;
+    for (pg::node_idx_t i = 0; i < m_graph->nodes().size(); ++i)
+    {
+        const pg::node_t &node = m_graph->node(i);
+        if (not node.is_equality_node() and not node.is_non_equality_node())
+        if (node_is_active(*sol, i))
+            literals.push_back(i);
+    }
+
+    wr.write(static_cast<uint32_t>(literals.size()));
+    for (auto i : literals)
+    {
+        const pg::node_t &node = m_graph->node(i);
+        wr.write(static_cast<int32_t>(i));
+        wr.write(static_cast<uint8_t>(node.type()));
+        wr.write(static_cast<int32_t>(node.depth()));
+        wr.write(node.to_string());
+    }
+
+    std::vector<pg::edge_idx_t> explanations, unifications;
+    for (pg::edge_idx_t i = 0; i < m_graph->edges().size(); ++i)
+    {
+        const pg::edge_t &edge = m_graph->edge(i);
+        if (not edge_is_active(*sol, i)) continue;
+
+        if (edge.is_chain_edge()) explanations.push_back(i);
+        else if (edge.is_unify_edge()) unifications.push_back(i);
+    }
+
+    wr.write(static_cast<uint32_t>(explanations.size()));
+    for (auto i : explanations)
+    {
+        const pg::edge_t &edge = m_graph->edge(i);
+        wr.write(static_cast<int32_t>(i));
+        wr.write(static_cast<uint8_t>(edge.type() == pg::EDGE_HYPOTHESIZE ? 1 : 0));
+        wr.write(m_graph->hypernode(edge.tail()));
+        wr.write(m_graph->hypernode(edge.head()));
+        wr.write(base->get_axiom_view(edge.axiom_id()).name());
+    }
+
+    wr.write(static_cast<uint32_t>(unifications.size()));
+    for (auto i : unifications)
+    {
+        const pg::edge_t &edge = m_graph->edge(i);
+        const std::vector<pg::node_idx_t> &hn_from(m_graph->hypernode(edge.tail()));
+
+        wr.write(static_cast<int32_t>(i));
+        wr.write(static_cast<int32_t>(hn_from[0]));
+        wr.write(static_cast<int32_t>(hn_from[1]));
+
+        if (edge.head() >= 0)
+        {
+            const std::vector<pg::node_idx_t> &hn_to(m_graph->hypernode(edge.head()));
+            wr.write(static_cast<uint32_t>(hn_to.size()));
+            for (auto n : hn_to)
+            {
+                const literal_t &lit = m_graph->node(n).literal();
+                wr.write(lit.terms[0].string() + "=" + lit.terms[1].string());
+            }
+        }
+        else
+            wr.write(static_cast<uint32_t>(0));
+    }
+
+    uint32_t size = static_cast<uint32_t>(buf.size());
+    os->write((const char*)&size, sizeof(uint32_t));
+    os->write(buf.data(), buf.size());
 }
 
 
@@ -1321,9 +2171,14 @@ void ilp_solution_t::print(std::ostream *os) const
 }
 
 
-void ilp_solution_t::print_graph(std::ostream *os) const
+void ilp_solution_t::print_graph(std::ostream *os, output_format_e fmt) const
 {
-    m_ilp->print_solution(this, os);
+    switch (fmt)
+    {
+    case OUTPUT_JSONL:  m_ilp->print_solution_in_jsonl(this, os); break;
+    case OUTPUT_BINARY: m_ilp->write_solution_in_binary(this, os); break;
+    default:            m_ilp->print_solution(this, os); break;
+    }
 }
 
 
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <climits>
+#include <limits>
 
 #include "./define.h"
 #include "./proof_graph.h"
@@ -117,6 +118,114 @@ private:
 };
 
 
+/** A contiguous representation of constraints in column-major order,
+ *  with which solvers can load an ILP-problem in bulk. */
+struct constraint_matrix_t
+{
+    inline size_t num_rows() const { return rows.size(); }
+    inline size_t num_columns() const
+    { return column_begins.empty() ? 0 : column_begins.size() - 1; }
+
+    /** The index of the constraint of each row. */
+    std::vector<constraint_idx_t> rows;
+
+    /** The operator and the bounds of each row.
+     *  A bound which the operator does not use is infinite. */
+    std::vector<constraint_operator_e> operators;
+    std::vector<double> lower_bounds, upper_bounds;
+
+    /** Coefficients of the j-th variable are stored in
+     *  [column_begins[j], column_begins[j + 1]) of row_indices and values,
+     *  in ascending order of rows. Coefficients of the same variable
+     *  in a constraint are summed up. */
+    std::vector<size_t> column_begins;
+    std::vector<int> row_indices;
+    std::vector<double> values;
+};
+
+
+/** A presolver which reduces an ILP-problem before it is passed to solvers.
+ *  It fixes variables by constants and singleton rows, drops empty,
+ *  redundant and forcing rows, merges parallel rows and substitutes
+ *  variables which are equivalent by rows of "x - y = 0".
+ *  Remaining variables are called columns, and solvers solve the problem
+ *  on columns, whose values are restored into values of all variables. */
+class presolver_t
+{
+public:
+    /** Builds the reduced problem.
+     *  If do_reduce is false or the problem is found infeasible,
+     *  the problem is passed as it is, so that solvers can report it.
+     *  @param excluded Constraints to be ignored, such as lazy ones. Can be NULL. */
+    void presolve(
+        const ilp_problem_t *prob, const hash_set<constraint_idx_t> *excluded,
+        bool do_reduce = true);
+
+    inline size_t num_columns() const { return m_columns.size(); }
+    inline variable_idx_t column(size_t j) const { return m_columns.at(j); }
+    inline double objective(size_t j) const { return m_obj.at(m_columns.at(j)); }
+    inline double lower_bound(size_t j) const { return m_lb.at(m_columns.at(j)); }
+    inline double upper_bound(size_t j) const { return m_ub.at(m_columns.at(j)); }
+
+    /** Rows of the reduced problem on columns.
+     *  The operator of each row is derived from its bounds. */
+    inline const constraint_matrix_t& matrix() const { return m_matrix; }
+
+    /** Gets the terms of the r-th row of matrix() in row-major order. */
+    void get_row(size_t r, std::vector<int> *cols, std::vector<double> *coefs) const;
+
+    /** Converts a constraint of the original problem into a row on columns,
+     *  such as a lazy constraint added in cutting-plane-inference.
+     *  Infinite bounds mean that the side is not bounded. */
+    void reduce(
+        const constraint_t &con, std::vector<int> *cols, std::vector<double> *coefs,
+        double *lower, double *upper) const;
+
+    /** Converts values of columns into values of all variables. */
+    void restore(const std::vector<double> &values, std::vector<double> *out) const;
+
+private:
+    struct row_t
+    {
+        std::vector<std::pair<variable_idx_t, double> > terms;
+        double lower, upper;
+        constraint_idx_t index;
+        bool is_alive;
+    };
+
+    static const int MAX_PASS_NUM = 16;
+
+    inline bool is_fixed(variable_idx_t v) const { return m_lb[v] == m_ub[v]; }
+    variable_idx_t find(variable_idx_t v) const;
+
+    /** Substitutes fixed and equivalent variables in the row. */
+    void normalize(
+        std::vector<std::pair<variable_idx_t, double> > *terms,
+        double *lower, double *upper) const;
+
+    /** Applies reductions with the row.
+     *  @return False if the problem is found infeasible. */
+    bool examine(row_t *row, bool *changed);
+
+    /** Merges rows whose coefficients are proportional. */
+    bool merge_parallel_rows();
+
+    void build();
+
+    bool m_do_reduce;
+
+    std::vector<row_t> m_rows;
+    std::vector<double> m_lb, m_ub, m_obj;
+    mutable std::vector<variable_idx_t> m_rep; /// For union-find.
+    mutable std::vector<int> m_position;
+
+    std::vector<variable_idx_t> m_columns;
+    std::vector<int> m_column_of;
+    std::vector<size_t> m_alive_rows;
+    constraint_matrix_t m_matrix;
+};
+
+
 /** A class of ILP-problem. */
 class ilp_problem_t
 {
@@ -126,7 +235,7 @@ public:
     static void enable_economization() { ms_do_economize = true; }
     static void disable_economization() { ms_do_economize = false; }
 
-    inline ilp_problem_t(
+    ilp_problem_t(
         const pg::proof_graph_t* lhs, solution_interpreter_t *si, bool do_maximize);
     virtual ~ilp_problem_t();
 
@@ -137,6 +246,11 @@ public:
     inline void timeout(bool flag) { m_is_timeout = flag; }
     inline bool has_timed_out() const { return m_is_timeout; }
 
+    /** Returns whether the conversion should be stopped, because the inference
+     *  has been cancelled or the number of constraints has exceeded
+     *  param("max_constraint_num"). This is cheap enough to call in loops. */
+    bool do_interrupt() const;
+
     /** Add a new decorator for outputting xml-files.
      *  You can use this method to customize output. */
     inline void add_xml_decorator(solution_xml_decorator_t *p_dec);
@@ -241,6 +355,13 @@ public:
 
     inline const pg::proof_graph_t* const proof_graph() const;
 
+    /** Exports constraints into a column-major matrix.
+     *  Buffers of the output are reused.
+     *  @param excluded Constraints not to be exported, such as lazy ones. Can be NULL. */
+    void export_constraints(
+        constraint_matrix_t *out,
+        const hash_set<constraint_idx_t> *excluded = NULL) const;
+
     /** Return the index of variable corresponding to the given node.
      *  If no variable is found, return -1. */
     inline variable_idx_t find_variable_with_node(pg::node_idx_t) const;
@@ -281,15 +402,33 @@ public:
         const ilp_solution_t &sol, pg::edge_idx_t idx) const;
 
     /** Print a xml-formatted proof-graph of the given solution.
-     *  You can customize its format by adding xml-decorators. */
+     *  You can customize its format by adding xml-decorators.
+     *  If the flag "compact_output" is set, inactive elements are omitted. */
     void print_solution(
         const ilp_solution_t *sol, std::ostream *os) const;
 
+    /** Print the active part of the given solution as one line of JSON.
+     *  This is faster to write and to parse than print_solution. */
+    void print_solution_in_jsonl(
+        const ilp_solution_t *sol, std::ostream *os) const;
+
+    /** Write the active part of the given solution as one binary record.
+     *  The output file must begin with the header by write_solution_header. */
+    void write_solution_in_binary(
+        const ilp_solution_t *sol, std::ostream *os) const;
+
+    /** Write the header of a file of binary solution records. */
+    static void write_solution_header(std::ostream *os);
+
 protected:
     void _print_requirements_in_solution(const ilp_solution_t *sol, std::ostream *os) const;
-    void _print_literals_in_solution(const ilp_solution_t *sol, std::ostream *os) const;
-    void _print_explanations_in_solution(const ilp_solution_t *sol, std::ostream *os) const;
-    void _print_unifications_in_solution(const ilp_solution_t *sol, std::ostream *os) const;
+    void _print_literals_in_solution(
+        const ilp_solution_t *sol, std::ostream *os, bool is_compact) const;
+    void _print_explanations_in_solution(
+        const ilp_solution_t *sol, std::ostream *os, bool is_compact) const;
+    void _print_unifications_in_solution(
+        const ilp_solution_t *sol, std::ostream *os, bool is_compact) const;
+    void _print_gaps_on_edge(pg::edge_idx_t idx, std::ostream *os) const;
 
     /** A sub-routine of add_constraints_of_exclusiveness_of_chains_from_*.
      *  @return Number of added constraints. */
@@ -302,6 +441,7 @@ protected:
 
     bool m_do_maximize;
     bool m_is_timeout; /// Whether conversion into ILP was timeout.
+    int m_max_constraint_num; /// The budget of constraints. Negative means no limit.
 
     const pg::proof_graph_t* const m_graph;
     
@@ -336,6 +476,15 @@ enum solution_type_e
 };
 
 
+/** Formats to output solution hypotheses in. */
+enum output_format_e
+{
+    OUTPUT_XML,    /// Verbose XML by print_solution.
+    OUTPUT_JSONL,  /// One JSON object per observation.
+    OUTPUT_BINARY  /// One binary record per observation.
+};
+
+
 /** A struct of a solution to a linear-programming-problem. */
 class ilp_solution_t
 {
@@ -378,7 +527,8 @@ public:
 
     std::string to_string() const;
     void print(std::ostream *os = &std::cout) const;
-    void print_graph(std::ostream *os = &std::cout) const; 
+    void print_graph(
+        std::ostream *os = &std::cout, output_format_e fmt = OUTPUT_XML) const;
    
 private:
     const ilp_problem_t* const m_ilp;
@@ -181,13 +181,6 @@ inline std::string constraint_t::to_string(
 }
 
 
-inline ilp_problem_t::ilp_problem_t(
-    const pg::proof_graph_t* lhs, solution_interpreter_t *si, bool do_maximize)
-    : m_do_maximize(do_maximize), m_is_timeout(false),
-      m_graph(lhs), m_cutoff(INVALID_CUT_OFF), m_solution_interpreter(si)
-{}
-
-
 inline void ilp_problem_t::add_xml_decorator(solution_xml_decorator_t *p_dec)
 {
     m_xml_decorators.push_back(p_dec);
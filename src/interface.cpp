@@ -36,6 +36,7 @@ void lhs_enumerator_t::add_observations(pg::proof_graph_t *target) const
 bool lhs_enumerator_t::do_time_out(const std::chrono::system_clock::time_point &begin) const
 {
     return
+        phillip()->cancellation().is_cancelled() or
         phillip()->timeout_lhs().do_time_out(begin) or
         phillip()->timeout_all().do_time_out(begin);
 }
@@ -47,7 +48,9 @@ void ilp_converter_t::convert_proof_graph(ilp::ilp_problem_t *prob) const
     const pg::proof_graph_t *graph = prob->proof_graph();
     auto begin = std::chrono::system_clock::now();
 
-#define _check_timeout if(do_time_out(begin)) { prob->timeout(true); return; }
+    /* THE TOKEN IS POLLED ON EVERY ITEM, WHICH READS THE CLOCK ONLY OCCASIONALLY. */
+#define _check_timeout if(prob->do_interrupt() or do_time_out(begin)) { prob->timeout(true); return; }
+#define _poll_timeout if(prob->do_interrupt()) { prob->timeout(true); return; }
 
     // ADD VARIABLES FOR NODES
     for (pg::node_idx_t i = 0; i < graph->nodes().size(); ++i)
@@ -56,47 +59,41 @@ void ilp_converter_t::convert_proof_graph(ilp::ilp_problem_t *prob) const
         if (graph->node(i).type() == pg::NODE_OBSERVABLE or
             graph->node(i).type() == pg::NODE_REQUIRED)
             prob->add_constancy_of_variable(var, 1.0);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     // ADD VARIABLES FOR HYPERNODES
     for (pg::hypernode_idx_t i = 0; i < graph->hypernodes().size(); ++i)
     {
         prob->add_variable_of_hypernode(i);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     for (pg::edge_idx_t i = 0; i < graph->edges().size(); ++i)
     {
         prob->add_variable_of_edge(i);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     // ADD CONSTRAINTS FOR NODES
     for (pg::node_idx_t i = 0; i < graph->nodes().size(); ++i)
     {
         prob->add_constraint_of_dependence_of_node_on_hypernode(i);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     // ADD CONSTRAINTS FOR HYPERNODES
     for (pg::hypernode_idx_t i = 0; i < graph->hypernodes().size(); ++i)
     {
         prob->add_constraint_of_dependence_of_hypernode_on_parents(i);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     // ADD CONSTRAINTS FOR CHAINING EDGES
     for (pg::edge_idx_t i = 0; i < graph->edges().size(); ++i)
     {
         prob->add_constrains_of_conditions_for_chain(i);
-        if (i % 100 == 0)
-            _check_timeout;
+        _poll_timeout;
     }
 
     prob->add_variables_for_requirement(false);
@@ -110,6 +107,9 @@ void ilp_converter_t::convert_proof_graph(ilp::ilp_problem_t *prob) const
 
     prob->add_constraints_of_transitive_unifications();
     _check_timeout;
+
+#undef _check_timeout
+#undef _poll_timeout
 }
 
 
@@ -119,6 +119,7 @@ bool ilp_converter_t::do_time_out(const std::chrono::system_clock::time_point &b
     duration_time_t t_all(phillip()->get_time_for_lhs() + t_ilp);
 
     return
+        phillip()->cancellation().is_cancelled() or
         phillip()->timeout_ilp().do_time_out(t_ilp) or
         phillip()->timeout_all().do_time_out(t_all);
 }
@@ -134,6 +135,7 @@ bool ilp_solver_t::do_time_out(const std::chrono::system_clock::time_point &begi
             phillip()->get_time_for_lhs() + phillip()->get_time_for_ilp() + t_sol;
 
         return
+            phillip()->cancellation().is_cancelled() or
             phillip()->timeout_sol().do_time_out(t_sol) or
             phillip()->timeout_all().do_time_out(t_all);
     }
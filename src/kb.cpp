@@ -1,11 +1,14 @@
 /* -*- coding: utf-8 -*- */
 
 #include <iomanip>
+#include <sstream>
 #include <cassert>
 #include <cstring>
 #include <climits>
 #include <algorithm>
 #include <thread>
+#include <atomic>
+#include <queue>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -39,7 +42,7 @@ unification_postponement_t::unification_postponement_t(
 }
 
 
-unification_postponement_t::unification_postponement_t(std::ifstream *fi)
+unification_postponement_t::unification_postponement_t(std::istream *fi)
 {
     small_size_t num_args;
 
@@ -54,7 +57,7 @@ unification_postponement_t::unification_postponement_t(std::ifstream *fi)
 }
 
 
-void unification_postponement_t::write(std::ofstream *fo) const
+void unification_postponement_t::write(std::ostream *fo) const
 {
     small_size_t num_args = m_args.size();
 
@@ -109,8 +112,12 @@ std::unique_ptr<knowledge_base_t, util::deleter_t<knowledge_base_t> > knowledge_
 std::string knowledge_base_t::ms_filename = "kb";
 float knowledge_base_t::ms_max_distance = -1.0f;
 int knowledge_base_t::ms_thread_num_for_rm = 1;
+size_t knowledge_base_t::ms_query_map_buffer_size = 256 << 20;
+size_t knowledge_base_t::ms_max_interned_patterns = 1 << 20;
 bool knowledge_base_t::ms_do_disable_stop_word = false;
-std::mutex knowledge_base_t::ms_mutex_for_cache;
+int knowledge_base_t::ms_cache_size = 10000;
+int knowledge_base_t::ms_distance_cache_size = 262144;
+bool knowledge_base_t::ms_do_verify_container = false;
 std::mutex knowledge_base_t::ms_mutex_for_rm;
 
 
@@ -127,7 +134,8 @@ knowledge_base_t* knowledge_base_t::instance()
 
 void knowledge_base_t::setup(
     std::string filename, float max_distance,
-    int thread_num_for_rm, bool do_disable_stop_word)
+    int thread_num_for_rm, bool do_disable_stop_word,
+    int cache_size, int distance_cache_size)
 {
     if (ms_instance != NULL)
         ms_instance.reset(NULL);
@@ -136,8 +144,12 @@ void knowledge_base_t::setup(
     ms_max_distance = max_distance;
     ms_thread_num_for_rm = thread_num_for_rm;
     ms_do_disable_stop_word = do_disable_stop_word;
+    ms_cache_size = cache_size;
+    ms_distance_cache_size = distance_cache_size;
 
     if (ms_thread_num_for_rm < 0) ms_thread_num_for_rm = 1;
+    if (ms_cache_size < 0) ms_cache_size = 0;
+    if (ms_distance_cache_size < 0) ms_distance_cache_size = 0;
 }
 
 
@@ -152,7 +164,11 @@ knowledge_base_t::knowledge_base_t(const std::string &filename)
       m_cdb_pattern_to_ids(filename + ".search.cdb"),
       m_axioms(filename),
       m_arity_db(filename + ".arity.dat"),
-      m_rm(filename + ".rm.dat")
+      m_rm(filename + ".rm.dat"),
+      m_cache_distance(ms_distance_cache_size),
+      m_cache_arity_patterns(ms_cache_size),
+      m_cache_pattern_to_ids(ms_cache_size),
+      m_num_pattern_scopes(0)
 {
     m_distance_provider = { NULL, "" };
     m_category_table = { NULL, "" };
@@ -185,6 +201,9 @@ void knowledge_base_t::prepare_compile()
 
     if (m_state == STATE_NULL)
     {
+        // REMOVES THE OLD CONTAINER SO THAT IT WILL NOT SHADOW NEW FILES.
+        std::remove((m_filename + ".kb").c_str());
+
         m_axioms.prepare_compile();
         m_cdb_rhs.prepare_compile();
         m_cdb_lhs.prepare_compile();
@@ -216,17 +235,38 @@ void knowledge_base_t::prepare_query()
 
     if (m_state == STATE_NULL)
     {
+        read_container();
         read_config();
-        m_arity_db.read();
-
-        m_axioms.prepare_query();
-        m_cdb_rhs.prepare_query();
-        m_cdb_lhs.prepare_query();
-        m_cdb_axiom_group.prepare_query();
-        m_cdb_arg_set.prepare_query();
-        m_cdb_arity_patterns.prepare_query();
-        m_cdb_pattern_to_ids.prepare_query();
-        m_rm.prepare_query();
+
+        auto arity = m_sections.find(".arity.dat");
+        if (arity != m_sections.end())
+            m_arity_db.prepare_query(arity->second.first, arity->second.second);
+        else
+            m_arity_db.prepare_query();
+
+        auto prepare_cdb = [this](util::cdb_data_t *dat, const std::string &suffix)
+        {
+            auto found = m_sections.find(suffix);
+            if (found != m_sections.end())
+                dat->prepare_query(found->second.first, found->second.second);
+            else
+                dat->prepare_query();
+        };
+
+        auto idx = m_sections.find(".index.dat");
+        auto dat = m_sections.find(".axioms.dat");
+        if (idx != m_sections.end() and dat != m_sections.end())
+            m_axioms.prepare_query(
+            idx->second.first, idx->second.second, dat->second.first);
+        else
+            m_axioms.prepare_query();
+        prepare_cdb(&m_cdb_rhs, ".rhs.cdb");
+        prepare_cdb(&m_cdb_lhs, ".lhs.cdb");
+        prepare_cdb(&m_cdb_axiom_group, ".group.cdb");
+        prepare_cdb(&m_cdb_arg_set, ".args.cdb");
+        prepare_cdb(&m_cdb_arity_patterns, ".pattern.cdb");
+        prepare_cdb(&m_cdb_pattern_to_ids, ".search.cdb");
+        m_rm.prepare_query(open_database(".rm.dat"));
         m_category_table.instance->prepare_query(this);
 
         m_state = STATE_QUERY;
@@ -241,6 +281,12 @@ void knowledge_base_t::finalize()
     kb_state_e state = m_state;
     m_state = STATE_NULL;
 
+    m_cache_arity_patterns.clear();
+    m_cache_pattern_to_ids.clear();
+    m_cache_distance.clear();
+    m_patterns.clear();
+    m_pattern_ids.clear();
+
     if (state == STATE_COMPILE)
     {
         auto insert_cdb = [](
@@ -323,6 +369,13 @@ void knowledge_base_t::finalize()
     m_cdb_pattern_to_ids.finalize();
     m_rm.finalize();
     m_category_table.instance->finalize();
+    m_arity_db.clear();
+
+    m_sections.clear();
+    m_container.close();
+
+    if (state == STATE_COMPILE)
+        write_container();
 }
 
 
@@ -355,7 +408,8 @@ void knowledge_base_t::write_config() const
 void knowledge_base_t::read_config()
 {
     std::string filename(m_filename + ".conf");
-    std::ifstream fi(filename.c_str(), std::ios::in | std::ios::binary);
+    std::unique_ptr<std::istream> p_fi(open_database(".conf"));
+    std::istream &fi(*p_fi);
     char version, num;
     char key[256];
 
@@ -389,9 +443,262 @@ void knowledge_base_t::read_config()
     fi.read(key, num);
     key[num] = '\0';
     set_category_table(key);
+}
+
+
+/** Suffixes of files which are packed into the single-file KB. */
+const char* const CONTAINER_SECTIONS[] = {
+    ".conf", ".arity.dat", ".index.dat", ".axioms.dat",
+    ".rhs.cdb", ".lhs.cdb", ".group.cdb", ".args.cdb",
+    ".pattern.cdb", ".search.cdb", ".rm.dat", ".category.dat" };
+
+const char CONTAINER_MAGIC[8] = { 'P', 'H', 'I', 'L', 'K', 'B', '\0', '\0' };
+const size_t CONTAINER_ALIGNMENT = 4096;
+
+struct container_header_t
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int num_sections;
+};
+
+struct container_section_t
+{
+    char name[32];
+    unsigned long long offset;
+    unsigned long long size;
+    unsigned int checksum;
+    unsigned int reserved;
+};
+
+
+/** Returns FNV-1a hash of given bytes, which is used as checksum. */
+static unsigned int get_checksum(const char *data, size_t size, unsigned int hash = 2166136261U)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+
+void knowledge_base_t::write_container() const
+{
+    std::string filename(m_filename + ".kb");
+    std::string tmpname(filename + ".tmp");
+    std::vector<container_section_t> sections;
+
+    IF_VERBOSE_1("starts writing " + filename + "...");
+
+    auto align = [](unsigned long long pos)
+    { return (pos + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT; };
+
+    unsigned long long pos =
+        sizeof(container_header_t) +
+        sizeof(container_section_t) * (sizeof(CONTAINER_SECTIONS) / sizeof(char*));
+
+    for (std::string suffix : CONTAINER_SECTIONS)
+    {
+        std::ifstream fi(
+            (m_filename + suffix).c_str(), std::ios::binary | std::ios::ate);
+        if (not fi) continue;
+
+        container_section_t sec;
+        std::memset(&sec, 0, sizeof(container_section_t));
+        std::strncpy(sec.name, suffix.c_str(), sizeof(sec.name) - 1);
+        sec.offset = pos = align(pos);
+        sec.size = static_cast<unsigned long long>(fi.tellg());
+        sec.checksum = get_checksum(NULL, 0);
+
+        sections.push_back(sec);
+        pos += sec.size;
+    }
+
+    std::ofstream fo(
+        tmpname.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+    if (not fo)
+        throw phillip_exception_t(
+        util::format("Cannot open KB file: \"%s\"", tmpname.c_str()));
+
+    auto fail = [&]()
+    {
+        fo.close();
+        std::remove(tmpname.c_str());
+        throw phillip_exception_t(
+            util::format("Cannot write KB file: \"%s\"", filename.c_str()));
+    };
+
+    container_header_t header;
+    std::memcpy(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    header.version = NUM_OF_KB_VERSION_TYPES - 1;
+    header.num_sections = sections.size();
+
+    fo.write((const char*)&header, sizeof(container_header_t));
+    fo.write((const char*)&sections[0], sizeof(container_section_t) * sections.size());
+
+    std::vector<char> buffer(1 << 20);
+
+    for (auto &sec : sections)
+    {
+        std::ifstream fi(
+            (m_filename + sec.name).c_str(), std::ios::binary | std::ios::in);
+
+        // PADDING
+        std::vector<char> zeros(sec.offset - fo.tellp(), '\0');
+        if (not zeros.empty())
+            fo.write(&zeros[0], zeros.size());
+
+        for (unsigned long long n = 0; n < sec.size;)
+        {
+            fi.read(&buffer[0], std::min<unsigned long long>(buffer.size(), sec.size - n));
+            size_t read = fi.gcount();
+            if (read == 0) fail();
+
+            sec.checksum = get_checksum(&buffer[0], read, sec.checksum);
+            fo.write(&buffer[0], read);
+            n += read;
+        }
+
+        if (not fo) fail();
+    }
+
+    // WRITES THE SECTION TABLE AGAIN WITH CHECKSUMS.
+    fo.seekp(sizeof(container_header_t), std::ios::beg);
+    fo.write((const char*)&sections[0], sizeof(container_section_t) * sections.size());
+    fo.close();
+
+    if (fo.fail() or std::rename(tmpname.c_str(), filename.c_str()) != 0)
+        fail();
+
+    // THE COMPONENT FILES ARE NO LONGER NEEDED,
+    // BECAUSE ALL OF THEM ARE PACKED INTO THE CONTAINER.
+    for (const auto &sec : sections)
+        std::remove((m_filename + sec.name).c_str());
+
+    IF_VERBOSE_1("completed writing " + filename + ".");
+}
+
+
+bool knowledge_base_t::read_container()
+{
+    std::string filename(m_filename + ".kb");
+
+    m_sections.clear();
+    m_container.close();
+
+    if (not util::do_exist_file(filename) or
+        not m_container.open(filename, util::cdb_data_t::do_use_mmap()))
+        return false;
+
+    const char *data = m_container.data();
+    size_t size = m_container.size();
+    const container_header_t *header = (const container_header_t*)data;
+
+    if (size < sizeof(container_header_t) or
+        std::memcmp(header->magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0)
+        throw phillip_exception_t(
+        "This compiled knowledge base is invalid. Please re-compile it.");
+
+    if (header->version != NUM_OF_KB_VERSION_TYPES - 1)
+        throw phillip_exception_t(
+        "This compiled knowledge base is too old. Please re-compile it.");
+
+    const container_section_t *sections =
+        (const container_section_t*)(data + sizeof(container_header_t));
+
+    if (size < sizeof(container_header_t) +
+        sizeof(container_section_t) * header->num_sections)
+        throw phillip_exception_t(
+        "This compiled knowledge base is broken. Please re-compile it.");
+
+    for (unsigned i = 0; i < header->num_sections; ++i)
+    {
+        const container_section_t &sec = sections[i];
+        std::string name(sec.name, ::strnlen(sec.name, sizeof(sec.name)));
+
+        if (sec.offset + sec.size > size)
+            throw phillip_exception_t(
+            "This compiled knowledge base is broken. Please re-compile it.");
+
+        if (ms_do_verify_container and
+            get_checksum(data + sec.offset, sec.size) != sec.checksum)
+            throw phillip_exception_t(util::format(
+            "Checksum of \"%s\" in the compiled knowledge base is inconsistent. "
+            "Please re-compile it.", name.c_str()));
+
+        m_sections[name] = std::make_pair(data + sec.offset, (size_t)sec.size);
+    }
+
+    IF_VERBOSE_2(util::format(
+        "Opened the knowledge base \"%s\" (%d sections).",
+        filename.c_str(), m_sections.size()));
+
+    return true;
+}
+
+
+std::pair<const char*, size_t> knowledge_base_t::find_section(const std::string &suffix) const
+{
+    auto found = m_sections.find(suffix);
+
+    if (found != m_sections.end())
+        return found->second;
+    else
+        return std::pair<const char*, size_t>(NULL, 0);
+}
 
-    fi.close();
 
+std::istream* knowledge_base_t::open_database(const std::string &suffix) const
+{
+    auto found = m_sections.find(suffix);
+
+    if (found != m_sections.end())
+        return new util::memory_istream_t(found->second.first, found->second.second);
+    else
+        return new std::ifstream(
+        (m_filename + suffix).c_str(), std::ios::in | std::ios::binary);
+}
+
+
+void knowledge_base_t::encode_implication(
+    const lf::logical_function_t &func, const std::string &name, implication_t *out)
+{
+    out->func = func;
+    out->name = name;
+    out->arities.clear();
+    out->lhs.clear();
+    out->rhs.clear();
+    out->binary.clear();
+
+    bool is_implication = func.is_valid_as_implication();
+    out->is_paraphrase = func.is_valid_as_paraphrase();
+    out->is_valid = (is_implication or out->is_paraphrase);
+
+    if (not out->is_valid) return;
+
+    std::vector<const lf::logical_function_t*> branches;
+    func.enumerate_literal_branches(&branches);
+    for (auto br : branches)
+        if (not br->literal().is_equality())
+            out->arities.push_back(br->literal().get_arity());
+
+    std::vector<const literal_t*> rhs(func.get_rhs());
+    std::vector<const literal_t*> lhs(func.get_lhs());
+
+    for (auto it = rhs.begin(); it != rhs.end(); ++it)
+        if (not (*it)->is_equality())
+            out->rhs.push_back((*it)->get_arity());
+
+    for (auto it = lhs.begin(); it != lhs.end(); ++it)
+        if (not (*it)->is_equality())
+            out->lhs.push_back((*it)->get_arity());
+
+    /* THE BUFFER IS REUSED AMONG AXIOMS ENCODED ON THE SAME THREAD. */
+    thread_local std::vector<char> buffer(BUFFER_SIZE);
+    size_t size = func.write_binary(&buffer[0]);
+    out->binary.assign(&buffer[0], size);
 }
 
 
@@ -400,53 +707,55 @@ axiom_id_t knowledge_base_t::insert_implication(
 {
     if (m_state == STATE_COMPILE)
     {
-        bool is_implication = func.is_valid_as_implication();
-        bool is_paraphrase = func.is_valid_as_paraphrase();
+        implication_t imp;
+        encode_implication(func, name, &imp);
+        return insert_implication(imp);
+    }
+    else
+        return INVALID_AXIOM_ID;
+}
 
-        if (not is_implication and not is_paraphrase)
+
+axiom_id_t knowledge_base_t::insert_implication(const implication_t &imp)
+{
+    if (m_state == STATE_COMPILE)
+    {
+        if (not imp.is_valid)
         {
             util::print_warning_fmt(
-                "Axiom \"%s\" is invalid and skipped.", func.to_string().c_str());
+                "Axiom \"%s\" is invalid and skipped.", imp.func.to_string().c_str());
             return INVALID_AXIOM_ID;
         }
 
         // ASSIGN ARITIES IN func TO ARITY-DATABASE.
-        std::vector<const lf::logical_function_t*> branches;
-        func.enumerate_literal_branches(&branches);
-        for (auto br : branches)
-            if (not br->literal().is_equality())
-                m_arity_db.add(br->literal().get_arity());
+        for (auto a : imp.arities)
+            m_arity_db.add(a);
 
         // IF func IS CATEGORICAL KNOWLEDGE, IT IS INSERTED TO CATEGORY-TABLE.
-        if (m_category_table.instance->insert(func))
+        if (m_category_table.instance->insert(imp.func))
             return INVALID_AXIOM_ID;
 
         axiom_id_t id = m_axioms.num_axioms();
-        m_axioms.put(name, func);
+        m_axioms.put(imp.name, imp.binary);
 
         // REGISTER AXIOMS'S GROUPS
-        auto spl = util::split(name, "#");
+        auto spl = util::split(imp.name, "#");
         if (spl.size() > 1)
         {
             for (int i = 0; i < spl.size() - 1; ++i)
                 m_group_to_axioms[spl[i]].insert(id);
         }
 
-        std::vector<const literal_t*> rhs(func.get_rhs());
-        std::vector<const literal_t*> lhs(func.get_lhs());
-
-        for (auto it = rhs.begin(); it != rhs.end(); ++it)
-        if (not (*it)->is_equality())
+        for (auto a : imp.rhs)
         {
-            arity_id_t arity_id = m_arity_db.add((*it)->get_arity());
+            arity_id_t arity_id = m_arity_db.add(a);
             m_rhs_to_axioms[arity_id].insert(id);
         }
 
-        for (auto it = lhs.begin(); it != lhs.end(); ++it)
-        if (not(*it)->is_equality())
+        for (auto a : imp.lhs)
         {
-            arity_id_t arity_id = m_arity_db.add((*it)->get_arity());
-            if (is_paraphrase)
+            arity_id_t arity_id = m_arity_db.add(a);
+            if (imp.is_paraphrase)
                 m_lhs_to_axioms[arity_id].insert(id);
         }
 
@@ -630,7 +939,7 @@ search_argument_set_id(const std::string &arity, int term_idx) const
 }
 
 
-void knowledge_base_t::search_arity_patterns(arity_id_t arity, std::list<arity_pattern_t> *out) const
+void knowledge_base_t::search_arity_patterns(arity_id_t arity, std::vector<pattern_id_t> *out) const
 {
     if (not m_cdb_arity_patterns.is_readable())
     {
@@ -638,25 +947,36 @@ void knowledge_base_t::search_arity_patterns(arity_id_t arity, std::list<arity_p
         return;
     }
 
+    if (m_cache_arity_patterns.get(arity, out))
+        return;
+
     size_t value_size;
     const char *value = (const char*)
         m_cdb_arity_patterns.get(&arity, sizeof(arity_id_t), &value_size);
 
+    out->clear();
     if (value != NULL)
     {
         size_t num_query, read_size(0);
+        arity_pattern_t query;
+
         read_size += util::binary_to<size_t>(value, &num_query);
-        out->assign(num_query, arity_pattern_t());
+        out->reserve(num_query);
 
-        for (auto it = out->begin(); it != out->end(); ++it)
-            read_size += binary_to_query(value + read_size, &(*it));
+        for (size_t i = 0; i < num_query; ++i)
+        {
+            size_t size = binary_to_query(value + read_size, &query);
+            out->push_back(intern_pattern(query, std::string(value + read_size, size)));
+            read_size += size;
+        }
     }
+
+    m_cache_arity_patterns.put(arity, *out);
 }
 
 
 void knowledge_base_t::search_axioms_with_arity_pattern(
-    const arity_pattern_t &query,
-    std::list<std::pair<axiom_id_t, bool> > *out) const
+    pattern_id_t query, std::list<std::pair<axiom_id_t, bool> > *out) const
 {
     if (not m_cdb_pattern_to_ids.is_readable())
     {
@@ -664,13 +984,15 @@ void knowledge_base_t::search_axioms_with_arity_pattern(
         return;
     }
 
-    std::vector<char> key;
-    query_to_binary(query, &key);
+    if (m_cache_pattern_to_ids.get(query, out))
+        return;
 
+    const std::string &key = pattern(query).binary();
     size_t value_size;
     const char *value = (const char*)
-        m_cdb_pattern_to_ids.get(&key[0], key.size(), &value_size);
+        m_cdb_pattern_to_ids.get(key.data(), key.size(), &value_size);
 
+    out->clear();
     if (value != NULL)
     {
         size_t size(0), num_id(0);
@@ -685,6 +1007,64 @@ void knowledge_base_t::search_axioms_with_arity_pattern(
             it->second = (flag != 0x00);
         }
     }
+
+    m_cache_pattern_to_ids.put(query, *out);
+}
+
+
+knowledge_base_t::pattern_scope_t::pattern_scope_t(const knowledge_base_t *base)
+    : m_base(base)
+{
+    std::unique_lock<std::mutex> lock(m_base->m_mutex_for_patterns);
+
+    if (m_base->m_patterns.size() > ms_max_interned_patterns)
+    {
+        // IDS HELD BY OPEN SCOPES MUST STAY VALID, SO WAIT FOR THEM TO CLOSE.
+        m_base->m_cv_for_patterns.wait(
+            lock, [this] { return m_base->m_num_pattern_scopes == 0; });
+
+        if (m_base->m_patterns.size() > ms_max_interned_patterns)
+        {
+            m_base->m_cache_arity_patterns.clear();
+            m_base->m_cache_pattern_to_ids.clear();
+            m_base->m_patterns.clear();
+            m_base->m_pattern_ids.clear();
+        }
+    }
+
+    ++m_base->m_num_pattern_scopes;
+}
+
+
+knowledge_base_t::pattern_scope_t::~pattern_scope_t()
+{
+    std::lock_guard<std::mutex> lock(m_base->m_mutex_for_patterns);
+
+    if (--m_base->m_num_pattern_scopes == 0)
+        m_base->m_cv_for_patterns.notify_all();
+}
+
+
+pattern_id_t knowledge_base_t::intern_pattern(
+    const arity_pattern_t &q, const std::string &bin) const
+{
+    // THE HASH IS COMPUTED OUTSIDE OF THE LOCK.
+    size_t hash = std::hash<std::string>()(bin);
+    std::lock_guard<std::mutex> lock(m_mutex_for_patterns);
+
+    std::vector<pattern_id_t> &ids = m_pattern_ids[hash];
+    for (auto id : ids)
+    {
+        const pattern_t &p = m_patterns[id];
+        if (p.hash() == hash and p.binary() == bin)
+            return id;
+    }
+
+    pattern_id_t id = static_cast<pattern_id_t>(m_patterns.size());
+    m_patterns.push_back(pattern_t(q, bin, hash));
+    ids.push_back(id);
+
+    return id;
 }
 
 
@@ -723,22 +1103,53 @@ void knowledge_base_t::set_category_table(
 float knowledge_base_t::get_distance(
     const std::string &arity1, const std::string &arity2 ) const
 {
-    arity_id_t get1 = search_arity_id(arity1);
-    arity_id_t get2 = search_arity_id(arity2);
-    if (get1 == INVALID_ARITY_ID or get2 == INVALID_ARITY_ID) return -1.0f;
+    return get_distance(search_arity_id(arity1), search_arity_id(arity2));
+}
+
+
+float knowledge_base_t::get_distance(arity_id_t arity1, arity_id_t arity2) const
+{
+    if (arity1 == INVALID_ARITY_ID or arity2 == INVALID_ARITY_ID) return -1.0f;
+
+    float dist;
+    if (m_cache_distance.get(arity1, arity2, &dist))
+        return dist;
+
+    dist = m_rm.get(arity1, arity2);
+    m_cache_distance.put(arity1, arity2, dist);
+    return dist;
+}
+
+
+void knowledge_base_t::get_distances(
+    arity_id_t arity, const std::vector<arity_id_t> &goals,
+    std::vector<float> *out) const
+{
+    out->assign(goals.size(), -1.0f);
+    if (arity == INVALID_ARITY_ID) return;
+
+    std::vector<size_t> missed, idx_missed;
 
-    std::lock_guard<std::mutex> lock(ms_mutex_for_cache);
-    auto found1 = m_cache_distance.find(get1);
-    if (found1 != m_cache_distance.end())
+    for (size_t i = 0; i < goals.size(); ++i)
     {
-        auto found2 = found1->second.find(get2);
-        if (found2 != found1->second.end())
-            return found2->second;
+        if (goals.at(i) == INVALID_ARITY_ID) continue;
+        if (not m_cache_distance.get(arity, goals.at(i), &(*out)[i]))
+        {
+            missed.push_back(goals.at(i));
+            idx_missed.push_back(i);
+        }
     }
 
-    float dist(m_rm.get(get1, get2));
-    m_cache_distance[get1][get2] = dist;
-    return dist;
+    if (missed.empty()) return;
+
+    std::vector<float> dists;
+    m_rm.gets(arity, missed, &dists);
+
+    for (size_t i = 0; i < missed.size(); ++i)
+    {
+        (*out)[idx_missed.at(i)] = dists.at(i);
+        m_cache_distance.put(arity, missed.at(i), dists.at(i));
+    }
 }
 
 
@@ -804,6 +1215,58 @@ void knowledge_base_t::insert_argument_set_to_cdb()
 }
 
 
+/** Selects arities to be stop-words greedily in descending order of coefficients.
+ *  An arity is selected unless all arities of some set in arity_sets are selected by it.
+ *  This is used instead of ILP when neither Gurobi nor lp_solve is available. */
+static void _select_stop_words_greedily(
+    const hash_map<arity_id_t, double> &coefs,
+    const std::set<std::vector<arity_id_t> > &arity_sets,
+    hash_set<arity_id_t> *out)
+{
+    /* THE NUMBER OF UNSELECTED ARITIES IN EACH SET. */
+    std::vector<int> remains;
+    hash_map<arity_id_t, std::vector<size_t> > a2s;
+
+    for (const auto &arities : arity_sets)
+    {
+        bool is_target(true);
+        for (auto a : arities)
+        if (coefs.count(a) == 0)
+            is_target = false;
+
+        if (not is_target) continue;
+
+        for (auto a : arities)
+            a2s[a].push_back(remains.size());
+        remains.push_back(arities.size());
+    }
+
+    std::vector<std::pair<arity_id_t, double> > sorted(coefs.begin(), coefs.end());
+    std::sort(sorted.begin(), sorted.end(),
+        [](const std::pair<arity_id_t, double> &x, const std::pair<arity_id_t, double> &y)
+    { return (x.second != y.second) ? (x.second > y.second) : (x.first < y.first); });
+
+    for (const auto &p : sorted)
+    {
+        auto found = a2s.find(p.first);
+        bool can_select(true);
+
+        if (found != a2s.end())
+        {
+            for (auto s : found->second)
+            if (remains[s] <= 1)
+                can_select = false;
+        }
+        if (not can_select) continue;
+
+        if (found != a2s.end())
+        for (auto s : found->second)
+            --remains[s];
+        out->insert(p.first);
+    }
+}
+
+
 void knowledge_base_t::set_stop_words()
 {
     bool can_use_lpsolve(false), can_use_gurobi(false);
@@ -814,124 +1277,180 @@ void knowledge_base_t::set_stop_words()
     can_use_gurobi = true;
 #endif
 
-    if (not can_use_gurobi and not can_use_lpsolve) return;
     if (ms_do_disable_stop_word) return;
 
     IF_VERBOSE_1("Setting stop-words...");
     m_axioms.prepare_query();
 
-    typedef std::pair <std::string, char> term_pos_t;
-    hash_map<arity_t, hash_set<term_idx_t> > candidates;
-    std::set<term_pos_t> excluded;
-    hash_map<std::string, size_t> counts; // ARITY FREQUENCY IN EVIDENCE
-    std::set<std::list<std::string> > arities_set; // ARITY SET IN EVIDENCE
-    hash_map<arity_t, hash_map<term_idx_t, std::list<std::string> > >
-        names_of_axiom_excludes_expected_stop_word;
+    typedef std::pair<arity_id_t, term_idx_t> arg_t;
+
+    /** Statistics of axioms, which each thread accumulates separately. */
+    struct stats_t
+    {
+        hash_map<arity_id_t, hash_set<term_idx_t> > candidates;
+        std::set<arg_t> excluded;
+        hash_map<arity_id_t, size_t> counts; // ARITY FREQUENCY IN EVIDENCE
+        std::set<std::vector<arity_id_t> > arity_sets; // ARITY SET IN EVIDENCE
+
+        /** The first axiom which excludes each argument of asserted stop-words. */
+        std::map<arg_t, axiom_id_t> excluders;
+    };
+
+    hash_set<arity_id_t> asserted;
+    for (const auto &a : m_asserted_stop_words)
+    {
+        arity_id_t id = search_arity_id(a);
+        if (id == INVALID_ARITY_ID)
+            throw phillip_exception_t(util::format(
+            "Stop-word assertion failed: "
+            "\"%s\" is not a candidate of stop-word.", a.c_str()));
+        asserted.insert(id);
+    }
 
-    auto proc = [&](const lf::axiom_t &ax, bool is_backward)
+    auto proc = [&](const lf::axiom_view_t &ax, bool is_backward, stats_t *st)
     {
-        auto evd = is_backward ? ax.func.get_rhs() : ax.func.get_lhs();
-        auto hyp = is_backward ? ax.func.get_lhs() : ax.func.get_rhs();
-        hash_set<term_t> terms_evd;
-        hash_map<term_t, std::list<term_pos_t> > hard_terms;
-        std::set<std::string> arities;
+        const std::vector<lf::axiom_view_t::literal_view_t>
+            &evd = is_backward ? ax.rhs() : ax.lhs(),
+            &hyp = is_backward ? ax.lhs() : ax.rhs();
+        hash_set<std::string> terms_evd;
+        hash_map<std::string, std::list<arg_t> > hard_terms;
+        std::set<arity_id_t> arities;
 
-        auto add_excluded = [&](const arity_t &a, term_idx_t i)
+        auto add_excluded = [&](arity_id_t a, term_idx_t i)
         {
-            if (m_asserted_stop_words.count(a) > 0)
-                names_of_axiom_excludes_expected_stop_word[a][i].push_back(ax.name);
-            excluded.insert(std::make_pair(a, i));
+            arg_t arg(a, i);
+            if (asserted.count(a) > 0 and st->excluders.count(arg) == 0)
+                st->excluders[arg] = ax.id();
+            st->excluded.insert(arg);
         };
-        
-        for (auto l : evd)
-        if (not l->is_equality())
+
+        for (const auto &l : evd)
+        if (l.predicate() != "=")
         {
-            std::string arity(l->get_arity());
+            arity_id_t arity = search_arity_id(l.arity());
 
             arities.insert(arity);
-            (counts.count(arity) > 0) ? ++counts[arity] : (counts[arity] = 1);
+            ++st->counts[arity];
 
-            for (char i = 0; i < l->terms.size(); ++i)
+            for (term_idx_t i = 0; i < l.num_terms; ++i)
             {
-                term_t t(l->terms.at(i));
-                terms_evd.insert(t);
-                if (t.is_hard_term())
-                    hard_terms[t].push_back(std::make_pair(arity, i));
+                std::string t(l.term(i));
+                if (term_t::is_hard_term_name(t))
+                    hard_terms[t].push_back(arg_t(arity, i));
                 else
                     add_excluded(arity, i);
+                terms_evd.insert(t);
             }
         }
 
-        std::list<std::string> arity_list(arities.begin(), arities.end());
-        arity_list.sort();
-        arities_set.insert(arity_list);
+        st->arity_sets.insert(std::vector<arity_id_t>(arities.begin(), arities.end()));
 
-        for (auto e : hard_terms)
+        for (const auto &e : hard_terms)
         if (e.second.size() > 1)
         {
             for (auto p : e.second)
-                candidates[p.first].insert(p.second);
+                st->candidates[p.first].insert(p.second);
         }
 
-        for (auto l : hyp)
-        if (not l->is_equality())
+        for (const auto &l : hyp)
+        if (l.predicate() != "=")
         {
-            for (char i = 0; i < l->terms.size(); ++i)
-            if (terms_evd.count(l->terms.at(i)) > 0)
-                add_excluded(l->get_arity(), i);
+            arity_id_t arity(INVALID_ARITY_ID);
+            for (term_idx_t i = 0; i < l.num_terms; ++i)
+            if (terms_evd.count(l.term(i)) > 0)
+            {
+                if (arity == INVALID_ARITY_ID)
+                    arity = search_arity_id(l.arity());
+                add_excluded(arity, i);
+            }
         }
     };
 
-    for (axiom_id_t id = 0; id < m_axioms.num_axioms(); ++id)
-    {
-        lf::axiom_t ax = m_axioms.get(id);
+    /* AXIOMS ARE SPLIT INTO CONTIGUOUS RANGES, EACH OF WHICH IS SCANNED BY A THREAD. */
+    int num_axioms = m_axioms.num_axioms();
+    int num_thread = std::max<int>(1,
+        std::min<int>(num_axioms,
+        std::min<int>(ms_thread_num_for_rm, std::thread::hardware_concurrency())));
+    std::vector<stats_t> stats(num_thread);
+    std::vector<std::thread> worker;
+    std::atomic<int> processed(0);
 
-        if (ax.func.is_operator(lf::OPR_IMPLICATION))
-            proc(ax, true);
-        else if (ax.func.is_operator(lf::OPR_PARAPHRASE))
+    for (int th_id = 0; th_id < num_thread; ++th_id)
+    {
+        worker.emplace_back([&](int th_id)
         {
-            proc(ax, true);
-            proc(ax, false);
-        }
+            axiom_id_t begin = (axiom_id_t)((long long)num_axioms * th_id / num_thread);
+            axiom_id_t end = (axiom_id_t)((long long)num_axioms * (th_id + 1) / num_thread);
 
-        if (id % 10 == 0 and phillip_main_t::verbose() >= VERBOSE_1)
-        {
-            float progress = (float)(id)* 100.0f / (float)m_axioms.num_axioms();
-            std::cerr << util::format("processed %d axioms [%.4f%%]\r", id, progress);
-        }
+            for (axiom_id_t id = begin; id < end; ++id)
+            {
+                lf::axiom_view_t ax = m_axioms.get_view(id);
+
+                if (ax.is_operator(lf::OPR_IMPLICATION))
+                    proc(ax, true, &stats[th_id]);
+                else if (ax.is_operator(lf::OPR_PARAPHRASE))
+                {
+                    proc(ax, true, &stats[th_id]);
+                    proc(ax, false, &stats[th_id]);
+                }
+
+                int n = ++processed;
+                if (th_id == 0 and n % 1000 == 0 and phillip_main_t::verbose() >= VERBOSE_1)
+                {
+                    float progress = (float)(n)* 100.0f / (float)num_axioms;
+                    std::cerr << util::format("processed %d axioms [%.4f%%]\r", n, progress);
+                }
+            }
+        }, th_id);
+    }
+    for (auto &t : worker) t.join();
+
+    /* MERGES THE STATISTICS OF THREADS INTO THE FIRST ONE. */
+    stats_t &all = stats.front();
+    for (int i = 1; i < num_thread; ++i)
+    {
+        stats_t &st = stats[i];
+
+        for (const auto &e : st.candidates)
+            all.candidates[e.first].insert(e.second.begin(), e.second.end());
+        for (const auto &e : st.counts)
+            all.counts[e.first] += e.second;
+        all.excluded.insert(st.excluded.begin(), st.excluded.end());
+        all.arity_sets.insert(st.arity_sets.begin(), st.arity_sets.end());
+
+        /* RANGES ARE IN ASCENDING ORDER, SO THE FIRST EXCLUDER IS KEPT. */
+        all.excluders.insert(st.excluders.begin(), st.excluders.end());
+
+        st = stats_t();
     }
 
     // CHECK WHETHER THERE ARE ASSERTED STOP-WORDS IN candidates
+    for (auto a : asserted)
     {
-        for (auto e : m_asserted_stop_words)
-        {
-            if (candidates.count(e) == 0)
-                throw phillip_exception_t(util::format(
-                "Stop-word assertion failed: "
-                "\"%s\" is not a candidate of stop-word.", e.c_str()));
-        }
+        if (all.candidates.count(a) == 0)
+            throw phillip_exception_t(util::format(
+            "Stop-word assertion failed: "
+            "\"%s\" is not a candidate of stop-word.", search_arity(a).c_str()));
     }
 
     // EXCLUDED ELEMENTS IN excluded FROM candidates
-    for (auto it1 = candidates.begin(); it1 != candidates.end();)
+    for (auto it1 = all.candidates.begin(); it1 != all.candidates.end();)
     {
         for (auto it2 = it1->second.begin(); it2 != it1->second.end();)
         {
-            term_pos_t p(it1->first, *it2);
-        
-            if (excluded.count(p) > 0)
+            arg_t p(it1->first, *it2);
+
+            if (all.excluded.count(p) > 0)
             {
-                if (m_asserted_stop_words.count(it1->first) > 0 and
-                    it1->second.size() == 1)
+                if (asserted.count(it1->first) > 0 and it1->second.size() == 1)
                 {
                     std::string ax_name =
-                        names_of_axiom_excludes_expected_stop_word
-                        .at(it1->first).at(*it2).front();
+                        m_axioms.get_view(all.excluders.at(p)).name();
                     std::string disp(util::format(
                         "Stop-word assertion failed: "
                         "\"%s\" cannot be a stop-word because of \"%s\".",
-                        it1->first.c_str(), ax_name.c_str()));
-                
+                        search_arity(it1->first).c_str(), ax_name.c_str()));
+
                     throw phillip_exception_t(disp);
                 }
                 it2 = it1->second.erase(it2);
@@ -940,62 +1459,71 @@ void knowledge_base_t::set_stop_words()
         }
 
         if (it1->second.empty())
-            it1 = candidates.erase(it1);
+            it1 = all.candidates.erase(it1);
         else ++it1;
     }
 
-    if (candidates.empty()) return;
-
-    hash_map<arity_t, ilp::variable_idx_t> a2v;
-    for (auto c : candidates)
-        a2v[c.first] = -1;
+    if (all.candidates.empty()) return;
 
-    ilp::ilp_problem_t prob(NULL, new ilp::basic_solution_interpreter_t(), true);
-
-    for (auto it = a2v.begin(); it != a2v.end(); ++it)
+    hash_map<arity_id_t, double> coefs;
+    for (const auto &c : all.candidates)
     {
-        double coef =
-            (m_asserted_stop_words.count(it->first) > 0) ? 100.0 :
-            100.0 * ((double)counts.at(it->first) - 0.9) / m_axioms.num_axioms();
-        ilp::variable_t var(it->first, coef);
-        it->second = prob.add_variable(var);
+        coefs[c.first] =
+            (asserted.count(c.first) > 0) ? 100.0 :
+            100.0 * ((double)all.counts.at(c.first) - 0.9) / num_axioms;
     }
 
-    for (auto arities : arities_set)
+    hash_set<arity_id_t> selected;
+
+    if (can_use_gurobi or can_use_lpsolve)
     {
-        bool do_add_constraint(true);
+        hash_map<arity_id_t, ilp::variable_idx_t> a2v;
+        ilp::ilp_problem_t prob(NULL, new ilp::basic_solution_interpreter_t(), true);
 
-        for (auto a : arities)
-        if (a2v.count(a) == 0)
-            do_add_constraint = false;
+        for (const auto &c : coefs)
+            a2v[c.first] = prob.add_variable(ilp::variable_t(search_arity(c.first), c.second));
 
-        if (do_add_constraint)
+        for (const auto &arities : all.arity_sets)
         {
-            ilp::constraint_t con("", ilp::OPR_LESS_EQ, 1.0 * (arities.size() - 1));
+            bool do_add_constraint(true);
+
             for (auto a : arities)
-                con.add_term(a2v.at(a), 1.0);
-            prob.add_constraint(con);
+            if (a2v.count(a) == 0)
+                do_add_constraint = false;
+
+            if (do_add_constraint)
+            {
+                ilp::constraint_t con("", ilp::OPR_LESS_EQ, 1.0 * (arities.size() - 1));
+                for (auto a : arities)
+                    con.add_term(a2v.at(a), 1.0);
+                prob.add_constraint(con);
+            }
         }
-    }
 
-    ilp_solver_t *solver = NULL;
-    if (can_use_gurobi) solver = new sol::gurobi_t(NULL, ms_thread_num_for_rm, false);
-    else solver = new sol::lp_solve_t(NULL);
+        ilp_solver_t *solver = NULL;
+        if (can_use_gurobi) solver = new sol::gurobi_t(NULL, ms_thread_num_for_rm, false);
+        else solver = new sol::lp_solve_t(NULL);
 
-    std::vector<ilp::ilp_solution_t> solutions;
-    solver->solve(&prob, &solutions);
+        std::vector<ilp::ilp_solution_t> solutions;
+        solver->solve(&prob, &solutions);
 
-    if (not solutions.empty())
-    if (solutions.front().type() == ilp::SOLUTION_OPTIMAL)
-    {
-        for (auto it : a2v)
+        if (not solutions.empty())
+        if (solutions.front().type() == ilp::SOLUTION_OPTIMAL)
         {
-            if (solutions.front().variable_is_active(it.second))
-                m_stop_words.insert(it.first);
+            for (auto it : a2v)
+            {
+                if (solutions.front().variable_is_active(it.second))
+                    selected.insert(it.first);
+            }
         }
+
+        delete solver;
     }
+    else
+        _select_stop_words_greedily(coefs, all.arity_sets, &selected);
 
-    delete solver;
+    for (auto a : selected)
+        m_stop_words.insert(search_arity(a));
 
     if (phillip_main_t::verbose() >= VERBOSE_3)
     {
@@ -1025,32 +1553,41 @@ void knowledge_base_t::create_query_map()
     m_cdb_rhs.prepare_query();
     m_cdb_lhs.prepare_query();
 
-    std::map<arity_id_t, std::set<arity_pattern_t> > arity_to_queries;
-    std::map<arity_pattern_t, std::set< std::pair<axiom_id_t, bool> > > pattern_to_ids;
+    /* PAIRS OF (PATTERN, AXIOM) AND OF (ARITY, PATTERN) ARE EXTRACTED IN PARALLEL
+     * AND ARE SORTED EXTERNALLY, SO THAT THE MEMORY USAGE DOES NOT DEPEND ON THE KB SIZE. */
+    typedef util::external_sorter_t::record_t record_t;
+    util::external_sorter_t pattern_to_ids(m_filename + ".search");
+    util::external_sorter_t arity_to_queries(m_filename + ".pattern");
+
+    hash_set<arity_id_t> stop_words;
+    for (const auto &a : m_stop_words)
+        stop_words.insert(search_arity_id(a));
 
-    auto proc = [this, &pattern_to_ids, &arity_to_queries](
-        const lf::axiom_t &ax, bool is_backward)
+    auto proc = [&](
+        const lf::axiom_view_t &ax, bool is_backward,
+        std::vector<record_t> *out_ids, std::vector<record_t> *out_queries) -> size_t
     {
-        std::vector<const lf::logical_function_t*> branches;
-        hash_map<string_hash_t, std::set<std::pair<arity_id_t, char> > > term2arity;
+        const std::vector<lf::axiom_view_t::literal_view_t>
+            &branches = is_backward ? ax.rhs() : ax.lhs();
+        hash_map<std::string, std::set<std::pair<arity_id_t, char> > > term2arity;
         arity_pattern_t query;
 
-        ax.func.branch(is_backward ? 1 : 0).enumerate_literal_branches(&branches);
-
         for (index_t i = 0; i < branches.size(); ++i)
         {
-            const literal_t &lit = branches[i]->literal();
-            if (lit.is_equality()) continue;
-            
-            std::string arity = lit.get_arity();
-            arity_id_t idx = search_arity_id(arity);
+            const lf::axiom_view_t::literal_view_t &lit = branches[i];
+            if (lit.predicate() == "=") continue;
+
+            arity_id_t idx = search_arity_id(lit.arity());
 
             assert(idx != INVALID_ARITY_ID);
             std::get<0>(query).push_back(idx);
 
-            for (int i_t = 0; i_t < lit.terms.size(); ++i_t)
-            if (lit.terms.at(i_t).is_hard_term())
-                term2arity[lit.terms.at(i_t)].insert(std::make_pair(i, (char)i_t));
+            for (int i_t = 0; i_t < lit.num_terms; ++i_t)
+            {
+                std::string t(lit.term(i_t));
+                if (term_t::is_hard_term_name(t))
+                    term2arity[t].insert(std::make_pair(i, (char)i_t));
+            }
         }
 
         for (auto e : term2arity)
@@ -1062,93 +1599,153 @@ void knowledge_base_t::create_query_map()
         std::get<1>(query).sort();
 
         for (char i = 0; i < branches.size(); ++i)
-        if (category_table()->do_target(branches[i]->literal().get_arity()))
+        if (category_table()->do_target(branches[i].arity()))
             std::get<2>(query).push_back(i);
 
-        pattern_to_ids[query].insert(std::make_pair(ax.id, is_backward));
+        std::vector<char> bin;
+        query_to_binary(query, &bin);
+        std::string key(bin.begin(), bin.end());
+        size_t size(0);
 
-        for (auto idx : std::get<0>(query))
-        if (m_stop_words.count(search_arity(idx)) == 0)
-            arity_to_queries[idx].insert(query);
-    };
+        /* AXIOM-IDS ARE WRITTEN IN BIG-ENDIAN, SO THAT THEY ARE SORTED IN ASCENDING ORDER. */
+        std::string val(sizeof(axiom_id_t) + 1, '\0');
+        for (int i = 0; i < sizeof(axiom_id_t); ++i)
+            val[i] = (char)((ax.id() >> (8 * (sizeof(axiom_id_t) - 1 - i))) & 0xff);
+        val.back() = is_backward ? 0x01 : 0x00;
 
-    for (axiom_id_t i = 0; i < m_axioms.num_axioms(); ++i)
-    {
-        lf::axiom_t ax = get_axiom(i);
+        out_ids->push_back(record_t(key, val));
+        size += key.size() + val.size();
 
-        if (ax.func.is_operator(lf::OPR_IMPLICATION))
-            proc(ax, true);
-        else if (ax.func.is_operator(lf::OPR_PARAPHRASE))
+        for (auto idx : std::get<0>(query))
+        if (stop_words.count(idx) == 0)
         {
-            proc(ax, true);
-            proc(ax, false);
+            out_queries->push_back(record_t(
+                std::string((const char*)&idx, sizeof(arity_id_t)), key));
+            size += sizeof(arity_id_t) + key.size();
         }
 
-        if (i % 10 == 0 and phillip_main_t::verbose() >= VERBOSE_1)
-        {
-            float progress = (float)(i)* 100.0f / (float)m_axioms.num_axioms();
-            std::cerr << util::format("processed %d axioms [%.4f%%]\r", i, progress);
-        }
-    }
+        return size;
+    };
 
-    m_cdb_arity_patterns.prepare_compile();
-    IF_VERBOSE_2("  Writing " + m_cdb_arity_patterns.filename() + "...");
+    int num_axioms = m_axioms.num_axioms();
+    int num_thread = std::max<int>(1,
+        std::min<int>(num_axioms,
+        std::min<int>(ms_thread_num_for_rm, std::thread::hardware_concurrency())));
+    size_t buffer_size = ms_query_map_buffer_size / num_thread;
+    std::vector<std::thread> worker;
+    std::atomic<int> processed(0);
 
-    for (auto p : arity_to_queries)
-    {
-        std::list< std::vector<char> > queries;
-        size_t size_value(0);
+    /* AN ERROR IN A WORKER IS PASSED TO THIS THREAD AND STOPS THE OTHER WORKERS. */
+    std::exception_ptr error;
+    std::mutex mutex_for_error;
+    std::atomic<bool> is_aborted(false);
 
-        size_value += sizeof(size_t);
-        for (auto q : p.second)
+    for (int th_id = 0; th_id < num_thread; ++th_id)
+    {
+        worker.emplace_back([&](int th_id)
         {
-            std::vector<char> bin;
-            query_to_binary(q, &bin);
-            queries.push_back(bin);
-            size_value += bin.size();
-        }
+            try
+            {
+                axiom_id_t begin = (axiom_id_t)((long long)num_axioms * th_id / num_thread);
+                axiom_id_t end = (axiom_id_t)((long long)num_axioms * (th_id + 1) / num_thread);
+                std::vector<record_t> ids, queries;
+                size_t size(0);
 
-        char *value = new char[size_value];
-        size_t size(0);
+                for (axiom_id_t i = begin; i < end and not is_aborted; ++i)
+                {
+                    lf::axiom_view_t ax = m_axioms.get_view(i);
 
-        size += util::to_binary<size_t>(p.second.size(), value);
-        for (auto q : queries)
-        {
-            std::memcpy(value + size, &q[0], q.size());
-            size += q.size();
-        }
+                    if (ax.is_operator(lf::OPR_IMPLICATION))
+                        size += proc(ax, true, &ids, &queries);
+                    else if (ax.is_operator(lf::OPR_PARAPHRASE))
+                    {
+                        size += proc(ax, true, &ids, &queries);
+                        size += proc(ax, false, &ids, &queries);
+                    }
 
-        assert(size == size_value);
-        m_cdb_arity_patterns.put(
-            (char*)(&p.first), sizeof(arity_id_t), value, size_value);
+                    // SPILLS THE BUFFER TO DISK
+                    if (size >= buffer_size)
+                    {
+                        pattern_to_ids.write_run(&ids);
+                        arity_to_queries.write_run(&queries);
+                        size = 0;
+                    }
 
-        delete[] value;
+                    int n = ++processed;
+                    if (th_id == 0 and n % 1000 == 0 and phillip_main_t::verbose() >= VERBOSE_1)
+                    {
+                        float progress = (float)(n)* 100.0f / (float)num_axioms;
+                        std::cerr << util::format("processed %d axioms [%.4f%%]\r", n, progress);
+                    }
+                }
+
+                if (not is_aborted)
+                {
+                    pattern_to_ids.write_run(&ids);
+                    arity_to_queries.write_run(&queries);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_for_error);
+                if (not error) error = std::current_exception();
+                is_aborted = true;
+            }
+        }, th_id);
     }
+    for (auto &t : worker) t.join();
+
+    if (error)
+        std::rethrow_exception(error);
+
+    IF_VERBOSE_3(util::format("    # of sorted runs = %d",
+        pattern_to_ids.num_runs() + arity_to_queries.num_runs()));
+
+    m_cdb_arity_patterns.prepare_compile();
+    IF_VERBOSE_2("  Writing " + m_cdb_arity_patterns.filename() + "...");
+
+    arity_to_queries.merge(
+        [this](const std::string &key, const std::vector<std::string> &queries)
+    {
+        std::string value;
+        size_t num(queries.size());
+
+        value.append((const char*)&num, sizeof(size_t));
+        for (const auto &q : queries)
+            value.append(q);
+
+        m_cdb_arity_patterns.put(key.data(), key.size(), value.data(), value.size());
+    });
 
     IF_VERBOSE_2("  Completed writing " + m_cdb_arity_patterns.filename() + ".");
     m_cdb_pattern_to_ids.prepare_compile();
     IF_VERBOSE_2("  Writing " + m_cdb_pattern_to_ids.filename() + "...");
 
-    for (auto p : pattern_to_ids)
+    int num_patterns(0);
+    pattern_to_ids.merge(
+        [this, &num_patterns](const std::string &key, const std::vector<std::string> &ids)
     {
-        std::vector<char> key, val;
-        query_to_binary(p.first, &key);
-
-        size_t size_val = sizeof(size_t) + (sizeof(axiom_id_t) + sizeof(char)) * p.second.size();
+        std::vector<char> val;
+        size_t size_val = sizeof(size_t) + (sizeof(axiom_id_t) + sizeof(char)) * ids.size();
         val.assign(size_val, '\0');
 
-        size_t size = util::to_binary<size_t>(p.second.size(), &val[0]);
-        for (auto p2 : p.second)
+        size_t size = util::to_binary<size_t>(ids.size(), &val[0]);
+        for (const auto &v : ids)
         {
-            size += util::to_binary<axiom_id_t>(p2.first, &val[0] + size);
-            size += util::to_binary<char>((p2.second ? 0xff : 0x00), &val[0] + size);
+            axiom_id_t id(0);
+            for (int i = 0; i < sizeof(axiom_id_t); ++i)
+                id = (id << 8) | (unsigned char)v[i];
+
+            size += util::to_binary<axiom_id_t>(id, &val[0] + size);
+            size += util::to_binary<char>((v.back() ? 0xff : 0x00), &val[0] + size);
         }
         assert(size == size_val);
 
-        m_cdb_pattern_to_ids.put(&key[0], key.size(), &val[0], val.size());
-    }
+        m_cdb_pattern_to_ids.put(key.data(), key.size(), &val[0], val.size());
+        ++num_patterns;
+    });
 
-    IF_VERBOSE_3(util::format("    # of patterns = %d", pattern_to_ids.size()));
+    IF_VERBOSE_3(util::format("    # of patterns = %d", num_patterns));
     IF_VERBOSE_2("  Completed writing " + m_cdb_pattern_to_ids.filename() + ".");
     IF_VERBOSE_1("Completed the arity patterns creation.");
 }
@@ -1277,10 +1874,10 @@ void knowledge_base_t::_create_reachable_matrix_direct(
 
     for (axiom_id_t id = 0; id < m_axioms.num_axioms(); ++id)
     {
-        lf::axiom_t axiom = get_axiom(id);
+        lf::axiom_view_t axiom = get_axiom_view(id);
 
-        if (axiom.func.is_operator(lf::OPR_IMPLICATION) or
-            axiom.func.is_operator(lf::OPR_PARAPHRASE))
+        if (axiom.is_operator(lf::OPR_IMPLICATION) or
+            axiom.is_operator(lf::OPR_PARAPHRASE))
         {
             float dist = (*m_distance_provider.instance)(axiom);
 
@@ -1289,12 +1886,12 @@ void knowledge_base_t::_create_reachable_matrix_direct(
                 hash_set<arity_id_t> lhs_ids, rhs_ids;
 
                 {
-                    std::vector<const literal_t*> lhs = axiom.func.get_lhs();
-                    std::vector<const literal_t*> rhs = axiom.func.get_rhs();
+                    const auto &lhs = axiom.lhs();
+                    const auto &rhs = axiom.rhs();
 
                     for (auto it_l = lhs.begin(); it_l != lhs.end(); ++it_l)
                     {
-                        std::string arity = (*it_l)->get_arity();
+                        std::string arity = it_l->arity();
                         arity_id_t idx = search_arity_id(arity);
 
                         if (idx != INVALID_ARITY_ID)
@@ -1304,7 +1901,7 @@ void knowledge_base_t::_create_reachable_matrix_direct(
 
                     for (auto it_r = rhs.begin(); it_r != rhs.end(); ++it_r)
                     {
-                        std::string arity = (*it_r)->get_arity();
+                        std::string arity = it_r->arity();
                         arity_id_t idx = search_arity_id(arity);
 
                         if (idx != INVALID_ARITY_ID)
@@ -1339,7 +1936,7 @@ void knowledge_base_t::_create_reachable_matrix_direct(
                     }
                 }
 
-                if (axiom.func.is_operator(lf::OPR_PARAPHRASE))
+                if (axiom.is_operator(lf::OPR_PARAPHRASE))
                 for (auto it_l = lhs_ids.begin(); it_l != lhs_ids.end(); ++it_l)
                 for (auto it_r = rhs_ids.begin(); it_r != rhs_ids.end(); ++it_r)
                     out_para->insert(util::make_sorted_pair(*it_l, *it_r));
@@ -1540,7 +2137,7 @@ std::mutex knowledge_base_t::axioms_database_t::ms_mutex;
 
 knowledge_base_t::axioms_database_t::axioms_database_t(const std::string &filename)
 : m_filename(filename),
-m_fo_idx(NULL), m_fo_dat(NULL), m_fi_idx(NULL), m_fi_dat(NULL),
+m_fo_idx(NULL), m_fo_dat(NULL), m_idx(NULL), m_dat(NULL),
 m_num_compiled_axioms(0), m_num_unnamed_axioms(0)
 {}
 
@@ -1578,19 +2175,35 @@ void knowledge_base_t::axioms_database_t::prepare_query()
 
     if (not is_readable())
     {
-        std::lock_guard<std::mutex> lock(ms_mutex);
+        std::string idx(m_filename + ".index.dat"), dat(m_filename + ".axioms.dat");
 
-        m_fi_idx = new std::ifstream(
-            (m_filename + ".index.dat").c_str(), std::ios::binary | std::ios::in);
-        m_fi_dat = new std::ifstream(
-            (m_filename + ".axioms.dat").c_str(), std::ios::binary | std::ios::in);
+        if (not m_map_idx.open(idx))
+            throw phillip_exception_t(
+            util::format("Cannot open KB file: \"%s\"", idx.c_str()));
 
-        m_fi_idx->seekg(-static_cast<int>(sizeof(int)), std::ios_base::end);
-        m_fi_idx->read((char*)&m_num_compiled_axioms, sizeof(int));
+        if (not m_map_dat.open(dat))
+            throw phillip_exception_t(
+            util::format("Cannot open KB file: \"%s\"", dat.c_str()));
+
+        prepare_query(m_map_idx.data(), m_map_idx.size(), m_map_dat.data());
     }
 }
 
 
+void knowledge_base_t::axioms_database_t::prepare_query(
+    const char *idx, size_t idx_size, const char *dat)
+{
+    if (is_writable())
+        finalize();
+
+    std::lock_guard<std::mutex> lock(ms_mutex);
+
+    m_idx = idx;
+    m_dat = dat;
+    std::memcpy(&m_num_compiled_axioms, idx + idx_size - sizeof(int), sizeof(int));
+}
+
+
 void knowledge_base_t::axioms_database_t::finalize()
 {
     if (is_writable())
@@ -1608,17 +2221,9 @@ void knowledge_base_t::axioms_database_t::finalize()
         m_fo_dat = NULL;
     }
 
-    if (m_fi_idx != NULL)
-    {
-        delete m_fi_idx;
-        m_fi_idx = NULL;
-    }
-
-    if (m_fi_dat != NULL)
-    {
-        delete m_fi_dat;
-        m_fi_dat = NULL;
-    }
+    m_idx = m_dat = NULL;
+    m_map_idx.close();
+    m_map_dat.close();
 }
 
 
@@ -1628,19 +2233,30 @@ void knowledge_base_t::axioms_database_t::put(
     const int SIZE(512 * 512);
     char buffer[SIZE];
 
-    /* AXIOM => BINARY-DATA */
     size_t size = func.write_binary(buffer);
-    size += util::string_to_binary(
-        (name.empty() ? get_name_of_unnamed_axiom() : name),
-        buffer + size);
-    assert(size < BUFFER_SIZE and size < ULONG_MAX);
+    put(name, std::string(buffer, size));
+}
+
+
+void knowledge_base_t::axioms_database_t::put(
+    const std::string &name, const std::string &binary)
+{
+    /* AXIOM => BINARY-DATA */
+    std::string _name(name.empty() ? get_name_of_unnamed_axiom() : name);
+    std::string name_bin(1 + _name.size(), '\0');
+    name_bin.resize(util::string_to_binary(_name, &name_bin[0]));
+
+    size_t size = binary.size() + name_bin.size();
+    if (size >= BUFFER_SIZE)
+        throw phillip_exception_t("Too large axiom: " + _name);
 
     /* INSERT AXIOM TO CDB.ID */
     axiom_size_t _size(static_cast<axiom_size_t>(size));
     m_fo_idx->write((char*)(&m_writing_pos), sizeof(axiom_pos_t));
     m_fo_idx->write((char*)(&_size), sizeof(axiom_size_t));
 
-    m_fo_dat->write(buffer, size);
+    m_fo_dat->write(binary.data(), binary.size());
+    m_fo_dat->write(name_bin.data(), name_bin.size());
 
     ++m_num_compiled_axioms;
     m_writing_pos += size;
@@ -1649,38 +2265,29 @@ void knowledge_base_t::axioms_database_t::put(
 
 lf::axiom_t knowledge_base_t::axioms_database_t::get(axiom_id_t id) const
 {
-    std::lock_guard<std::mutex> lock(ms_mutex);
-    lf::axiom_t out;
+    return get_view(id).to_axiom();
+}
 
+
+lf::axiom_view_t knowledge_base_t::axioms_database_t::get_view(axiom_id_t id) const
+{
     if (not is_readable())
     {
         util::print_warning("kb-search: KB is currently not readable.");
-        return out;
+        return lf::axiom_view_t();
     }
 
+    /* THE DATA IS READ-ONLY ON MEMORY, SO NO LOCK IS NEEDED. */
     axiom_pos_t pos;
-    axiom_size_t size;
-    const int SIZE(512 * 512);
-    char buffer[SIZE];
-
-    m_fi_idx->seekg(id * (sizeof(axiom_pos_t)+sizeof(axiom_size_t)));
-    m_fi_idx->read((char*)&pos, sizeof(axiom_pos_t));
-    m_fi_idx->read((char*)&size, sizeof(axiom_size_t));
+    std::memcpy(&pos, m_idx + id * (sizeof(axiom_pos_t)+sizeof(axiom_size_t)), sizeof(axiom_pos_t));
 
-    m_fi_dat->seekg(pos);
-    m_fi_dat->read(buffer, size);
-
-    out.id = id;
-    size_t _size = out.func.read_binary(buffer);
-    _size += util::binary_to_string(buffer + _size, &out.name);
-
-    return out;
+    return lf::axiom_view_t(id, m_dat + pos);
 }
 
 
 
 knowledge_base_t::arity_database_t::arity_database_t(const std::string &filename)
-: m_filename(filename)
+: m_filename(filename), m_header(NULL)
 {
     m_arities.push_back("");
     m_arity2id[""] = INVALID_ARITY_ID;
@@ -1696,123 +2303,272 @@ void knowledge_base_t::arity_database_t::clear()
 
     m_unification_postponements.clear();
     m_mutual_exclusions.clear();
+
+    m_header = NULL;
+    m_offsets = NULL;
+    m_displacements = m_slots = NULL;
+    m_blob = NULL;
+    m_muexs = NULL;
+    m_muex_pairs = NULL;
+    m_unipps.clear();
+    m_map.close();
 }
 
 
-void knowledge_base_t::arity_database_t::read()
+/** Returns the size of a padding to align given position to 8 bytes. */
+inline size_t get_padding(size_t pos)
 {
-    std::ifstream fi(m_filename.c_str(), std::ios::in | std::ios::binary);
-    char line[256];
+    return (8 - pos % 8) % 8;
+}
 
-    clear();
 
-    if (fi.bad())
+void knowledge_base_t::arity_database_t::prepare_query()
+{
+    if (not m_map.open(m_filename))
         throw phillip_exception_t("Failed to open " + m_filename);
 
-    size_t arity_num;
-    fi.read((char*)&arity_num, sizeof(size_t));
+    prepare_query(m_map.data(), m_map.size());
+}
 
-    for (size_t i = 0; i < arity_num; ++i)
-    {
-        unsigned char num_char;
-        fi.read((char*)&num_char, sizeof(unsigned char));
-        fi.read(line, sizeof(char) * num_char);
-        line[num_char] = '\0';
 
-        add(arity_t(line));
-    }
+void knowledge_base_t::arity_database_t::prepare_query(const char *data, size_t size)
+{
+    const header_t *header = (const header_t*)data;
+    size_t n = sizeof(header_t);
 
-    size_t unipp_num;
-    fi.read((char*)&unipp_num, sizeof(size_t));
+    if (size < n)
+        throw phillip_exception_t("Broken file: " + m_filename);
 
-    for (size_t i = 0; i < unipp_num; ++i)
-        add_unification_postponement(unification_postponement_t(&fi));
+    m_offsets = (const unsigned long long*)(data + n);
+    n += sizeof(unsigned long long) * (header->num_arities + 1);
 
-    size_t muex_num_1;
-    fi.read((char*)&muex_num_1, sizeof(size_t));
+    m_displacements = (const unsigned int*)(data + n);
+    n += sizeof(unsigned int) * header->num_buckets;
+    n += get_padding(n);
 
-    for (size_t i = 0; i < muex_num_1; ++i)
-    {
-        size_t muex_num_2;
-        arity_id_t id1;
-        fi.read((char*)&id1, sizeof(arity_id_t));
-        fi.read((char*)&muex_num_2, sizeof(size_t));
+    m_slots = (const unsigned int*)(data + n);
+    n += sizeof(unsigned int) * header->num_arities;
+    n += get_padding(n);
 
-        for (size_t j = 0; j < muex_num_2; ++j)
-        {
-            arity_id_t id2;
-            small_size_t pairs_num;
-            std::list<std::pair<term_idx_t, term_idx_t> > pairs;
+    m_blob = data + n;
+    n += header->blob_size;
+    n += get_padding(n);
 
-            fi.read((char*)&id2, sizeof(arity_id_t));
-            fi.read((char*)&pairs_num, sizeof(small_size_t));
+    util::memory_istream_t fi_unipp(data + n, header->unipp_size);
+    n += header->unipp_size;
+    n += get_padding(n);
 
-            for (small_size_t k = 0; k < pairs_num; ++k)
-            {
-                term_idx_t terms[2];
-                fi.read((char*)terms, sizeof(term_idx_t) * 2);
+    m_muexs = (const muex_t*)(data + n);
+    n += sizeof(muex_t) * header->num_muexs;
 
-                pairs.push_back(std::make_pair(terms[0], terms[1]));
-            }
+    m_muex_pairs = (const term_pair_t*)(data + n);
+    n += sizeof(term_pair_t) * header->num_muex_pairs;
 
-            m_mutual_exclusions[id1][id2] = pairs;
-        }
-    }
+    if (size < n)
+        throw phillip_exception_t("Broken file: " + m_filename);
+
+    // UNIFICATION-POSTPONEMENTS ARE FEW, SO THEY ARE DECODED HERE.
+    m_unipps.clear();
+    m_unipps.reserve(header->num_unipps);
+    for (size_t i = 0; i < header->num_unipps; ++i)
+        m_unipps.push_back(unification_postponement_t(&fi_unipp));
+
+    m_header = header;
 }
 
 
 void knowledge_base_t::arity_database_t::write() const
 {
     std::ofstream fo(m_filename.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
-    char line[256];
+    const char zeros[8] = { 0 };
 
     if (fo.bad())
         throw phillip_exception_t("Failed to open " + m_filename);
 
-    size_t arity_num = m_arities.size();
-    fo.write((char*)&arity_num, sizeof(size_t));
+    header_t header;
+    std::memset(&header, 0, sizeof(header_t));
+    header.num_arities = m_arities.size();
+    header.num_buckets = m_arities.size() / 4 + 1;
 
+    // STRING POOL
+    std::vector<unsigned long long> offsets(1, 0);
     for (auto arity : m_arities)
+        offsets.push_back(offsets.back() + arity.length());
+    header.blob_size = offsets.back();
+
+    // MINIMAL PERFECT HASH (HASH AND DISPLACE)
+    std::vector<std::vector<arity_id_t> > buckets(header.num_buckets);
+    for (arity_id_t i = 0; i < m_arities.size(); ++i)
     {
-        small_size_t num_char = arity.length();
-        fo.write((char*)&num_char, sizeof(small_size_t));
-        fo.write(arity.c_str(), sizeof(char)* num_char);
+        const arity_t &a = m_arities.at(i);
+        buckets[hash(a.c_str(), a.length(), 0) % header.num_buckets].push_back(i);
     }
 
-    size_t unipp_num = m_unification_postponements.size();
-    fo.write((char*)&unipp_num, sizeof(size_t));
-
-    for (auto p : m_unification_postponements)
-        p.second.write(&fo);
+    std::vector<size_t> order(header.num_buckets);
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t x, size_t y)
+    { return buckets.at(x).size() > buckets.at(y).size(); });
 
-    size_t muex_num_1 = m_mutual_exclusions.size();
-    fo.write((char*)&muex_num_1, sizeof(size_t));
+    std::vector<unsigned int> displacements(header.num_buckets, 0);
+    std::vector<unsigned int> slots(header.num_arities, 0);
+    std::vector<bool> is_used(header.num_arities, false);
+    std::vector<size_t> assigned;
 
-    for (auto p1 : m_mutual_exclusions)
+    for (auto b : order)
     {
-        size_t muex_num_2 = p1.second.size();
-        fo.write((char*)&p1.first, sizeof(arity_id_t));
-        fo.write((char*)&muex_num_2, sizeof(size_t));
+        const std::vector<arity_id_t> &bucket = buckets.at(b);
+        if (bucket.empty()) break;
 
-        for (auto p2 : p1.second)
+        for (unsigned int d = 1;; ++d)
         {
-            small_size_t pairs_num = p2.second.size();
-            fo.write((char*)&p2.first, sizeof(arity_id_t));
-            fo.write((char*)&pairs_num, sizeof(small_size_t));
+            assigned.clear();
 
-            for (auto p3 : p2.second)
+            for (auto id : bucket)
             {
-                term_idx_t terms[2] = { p3.first, p3.second };
-                fo.write((char*)terms, sizeof(term_idx_t)* 2);
+                const arity_t &a = m_arities.at(id);
+                size_t slot = hash(a.c_str(), a.length(), d) % header.num_arities;
+
+                if (is_used.at(slot) or
+                    std::find(assigned.begin(), assigned.end(), slot) != assigned.end())
+                    break;
+                assigned.push_back(slot);
+            }
+
+            if (assigned.size() == bucket.size())
+            {
+                for (size_t i = 0; i < bucket.size(); ++i)
+                {
+                    is_used[assigned.at(i)] = true;
+                    slots[assigned.at(i)] = static_cast<unsigned int>(bucket.at(i));
+                }
+                displacements[b] = d;
+                break;
             }
         }
     }
+
+    // UNIFICATION-POSTPONEMENTS, SORTED BY ARITY
+    std::map<arity_id_t, const unification_postponement_t*> unipps;
+    for (auto &p : m_unification_postponements)
+        unipps[p.first] = &p.second;
+
+    std::ostringstream unipp_stream;
+    for (auto p : unipps)
+        p.second->write(&unipp_stream);
+    std::string unipp_data = unipp_stream.str();
+
+    header.num_unipps = unipps.size();
+    header.unipp_size = unipp_data.size();
+
+    // MUTUAL-EXCLUSIONS, SORTED BY PAIR OF ARITIES
+    std::vector<muex_t> muexs;
+    std::vector<term_pair_t> muex_pairs;
+
+    for (auto p1 : m_mutual_exclusions)
+    for (auto p2 : p1.second)
+    {
+        muex_t m = { p1.first, p2.first, 0, 0 };
+        muexs.push_back(m);
+    }
+    std::sort(muexs.begin(), muexs.end(), [](const muex_t &x, const muex_t &y)
+    { return (x.arity1 != y.arity1) ? (x.arity1 < y.arity1) : (x.arity2 < y.arity2); });
+
+    for (auto &m : muexs)
+    {
+        const auto &pairs = m_mutual_exclusions.at(m.arity1).at(m.arity2);
+        m.begin = static_cast<unsigned int>(muex_pairs.size());
+        muex_pairs.insert(muex_pairs.end(), pairs.begin(), pairs.end());
+        m.end = static_cast<unsigned int>(muex_pairs.size());
+    }
+
+    header.num_muexs = muexs.size();
+    header.num_muex_pairs = muex_pairs.size();
+
+    // WRITING
+    auto write = [&fo, &zeros](const void *data, size_t size, bool do_align)
+    {
+        if (size > 0)
+            fo.write((const char*)data, size);
+        if (do_align)
+            fo.write(zeros, get_padding(fo.tellp()));
+    };
+
+    write(&header, sizeof(header_t), false);
+    write(&offsets[0], sizeof(unsigned long long) * offsets.size(), false);
+    write(&displacements[0], sizeof(unsigned int) * displacements.size(), true);
+    write(&slots[0], sizeof(unsigned int) * slots.size(), true);
+
+    for (auto arity : m_arities)
+        fo.write(arity.c_str(), arity.length());
+    write(NULL, 0, true);
+
+    write(unipp_data.data(), unipp_data.size(), true);
+    write(muexs.empty() ? NULL : &muexs[0], sizeof(muex_t) * muexs.size(), false);
+    write(muex_pairs.empty() ? NULL : &muex_pairs[0],
+        sizeof(term_pair_t) * muex_pairs.size(), false);
+}
+
+
+unsigned long long knowledge_base_t::arity_database_t::hash(
+    const char *str, size_t len, unsigned long long seed)
+{
+    unsigned long long h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+
+    for (size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 1099511628211ULL;
+    }
+
+    return h ^ (h >> 29);
+}
+
+
+arity_id_t knowledge_base_t::arity_database_t::search_perfect_hash(const arity_t &arity) const
+{
+    if (m_header->num_arities == 0) return INVALID_ARITY_ID;
+
+    unsigned int d = m_displacements[
+        hash(arity.c_str(), arity.length(), 0) % m_header->num_buckets];
+    if (d == 0) return INVALID_ARITY_ID;
+
+    unsigned int id = m_slots[
+        hash(arity.c_str(), arity.length(), d) % m_header->num_arities];
+
+    // THE HASH IS PERFECT ONLY FOR REGISTERED ARITIES, SO THE STRING IS CHECKED.
+    size_t len = m_offsets[id + 1] - m_offsets[id];
+    if (len != arity.length() or
+        std::memcmp(m_blob + m_offsets[id], arity.c_str(), len) != 0)
+        return INVALID_ARITY_ID;
+
+    return id;
+}
+
+
+util::array_view_t<knowledge_base_t::arity_database_t::term_pair_t>
+knowledge_base_t::arity_database_t::find_inconsistent_terms(arity_id_t a1, arity_id_t a2) const
+{
+    assert(a1 <= a2);
+
+    if (m_header == NULL) return util::array_view_t<term_pair_t>();
+
+    const muex_t *end = m_muexs + m_header->num_muexs;
+    const muex_t *found = std::lower_bound(
+        m_muexs, end, std::make_pair(a1, a2),
+        [](const muex_t &m, const std::pair<arity_id_t, arity_id_t> &p)
+    { return (m.arity1 != p.first) ? (m.arity1 < p.first) : (m.arity2 < p.second); });
+
+    if (found == end or found->arity1 != a1 or found->arity2 != a2)
+        return util::array_view_t<term_pair_t>();
+
+    return util::array_view_t<term_pair_t>(
+        m_muex_pairs + found->begin, m_muex_pairs + found->end);
 }
 
 
 void knowledge_base_t::arity_database_t::add_mutual_exclusion(const literal_t &l1, const literal_t &l2)
 {
-    std::list< std::pair<term_idx_t, term_idx_t> > pairs;
+    std::list<term_pair_t> pairs;
 
     for (term_idx_t t1 = 0; t1 < l1.terms.size(); ++t1)
     for (term_idx_t t2 = 0; t2 < l2.terms.size(); ++t2)
@@ -1870,13 +2626,23 @@ void knowledge_base_t::reachable_matrix_t::prepare_query()
         finalize();
 
     if (not is_readable())
+    {
+        prepare_query(new std::ifstream(
+            m_filename.c_str(), std::ios::binary | std::ios::in));
+    }
+}
+
+
+void knowledge_base_t::reachable_matrix_t::prepare_query(std::istream *fin)
+{
+    finalize();
+
     {
         std::lock_guard<std::mutex> lock(ms_mutex);
         pos_t pos;
         size_t num, idx;
 
-        m_fin = new std::ifstream(
-            m_filename.c_str(), std::ios::binary | std::ios::in);
+        m_fin = fin;
 
         m_fin->read((char*)&pos, sizeof(pos_t));
         m_fin->seekg(pos, std::ios::beg);
@@ -1997,12 +2763,141 @@ hash_set<float> knowledge_base_t::reachable_matrix_t::get(size_t idx) const
 }
 
 
+void knowledge_base_t::reachable_matrix_t::gets(
+    size_t idx1, const std::vector<size_t> &idx2s, std::vector<float> *out) const
+{
+    out->assign(idx2s.size(), -1.0f);
+
+    std::lock_guard<std::mutex> lock(ms_mutex);
+    size_t num, idx;
+    float dist;
+
+    // A ROW HAS ONLY ELEMENTS WHOSE INDICES ARE NOT LESS THAN ITS OWN ONE.
+    hash_map<size_t, std::list<size_t> > targets;
+    for (size_t i = 0; i < idx2s.size(); ++i)
+    {
+        if (idx2s.at(i) >= idx1)
+            targets[idx2s.at(i)].push_back(i);
+        else
+        {
+            auto find = m_map_idx_to_pos.find(idx2s.at(i));
+            if (find == m_map_idx_to_pos.end()) continue;
+
+            m_fin->seekg(find->second, std::ios::beg);
+            m_fin->read((char*)&num, sizeof(size_t));
+
+            for (size_t j = 0; j < num; ++j)
+            {
+                m_fin->read((char*)&idx, sizeof(size_t));
+                m_fin->read((char*)&dist, sizeof(float));
+                if (idx == idx1)
+                {
+                    (*out)[i] = dist;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (targets.empty()) return;
+
+    auto find = m_map_idx_to_pos.find(idx1);
+    if (find == m_map_idx_to_pos.end()) return;
+
+    m_fin->seekg(find->second, std::ios::beg);
+    m_fin->read((char*)&num, sizeof(size_t));
+
+    for (size_t i = 0; i < num; ++i)
+    {
+        m_fin->read((char*)&idx, sizeof(size_t));
+        m_fin->read((char*)&dist, sizeof(float));
+
+        auto found = targets.find(idx);
+        if (found != targets.end())
+        {
+            for (auto j : found->second)
+                (*out)[j] = dist;
+        }
+    }
+}
+
+
+knowledge_base_t::distance_cache_t::distance_cache_t(size_t size)
+    : m_mask(0)
+{
+    if (size == 0) return;
+
+    size_t n(1);
+    while (n < size) n <<= 1;
+
+    m_entries.reset(new entry_t[n]);
+    m_mask = n - 1;
+    clear();
+}
+
+
+bool knowledge_base_t::distance_cache_t::get(
+    arity_id_t a1, arity_id_t a2, float *out) const
+{
+    unsigned long long key = to_key(a1, a2);
+    if (not m_entries or key == 0) return false;
+
+    const entry_t &e = slot(key);
+    unsigned seq1 = e.seq.load(std::memory_order_acquire);
+    if (seq1 & 1) return false;
+
+    unsigned long long k = e.key.load(std::memory_order_relaxed);
+    float v = e.value.load(std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (e.seq.load(std::memory_order_relaxed) != seq1 or k != key)
+        return false;
+
+    *out = v;
+    return true;
+}
+
+
+void knowledge_base_t::distance_cache_t::put(
+    arity_id_t a1, arity_id_t a2, float dist)
+{
+    unsigned long long key = to_key(a1, a2);
+    if (not m_entries or key == 0) return;
+
+    entry_t &e = slot(key);
+    unsigned seq = e.seq.load(std::memory_order_relaxed);
+
+    // IF ANOTHER THREAD IS WRITING THIS SLOT, GIVES UP CACHING.
+    if ((seq & 1) or
+        not e.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire))
+        return;
+
+    std::atomic_thread_fence(std::memory_order_release);
+    e.key.store(key, std::memory_order_relaxed);
+    e.value.store(dist, std::memory_order_relaxed);
+    e.seq.store(seq + 2, std::memory_order_release);
+}
+
+
+void knowledge_base_t::distance_cache_t::clear()
+{
+    for (size_t i = 0; m_entries and i <= m_mask; ++i)
+    {
+        m_entries[i].seq.store(0, std::memory_order_relaxed);
+        m_entries[i].key.store(0, std::memory_order_relaxed);
+        m_entries[i].value.store(0.0f, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+
 namespace dist
 {
 
-float basic_distance_provider_t::operator()(const lf::axiom_t &ax) const
+/** Returns the distance written in the parameter of an axiom as "d<float>". */
+static float param_to_basic_distance(const std::string &param)
 {
-    auto splitted = util::split(ax.func.param(), ":");
+    auto splitted = util::split(param, ":");
     float dist;
 
     for (auto s : splitted)
@@ -2015,14 +2910,38 @@ float basic_distance_provider_t::operator()(const lf::axiom_t &ax) const
 }
 
 
-float cost_based_distance_provider_t::operator()(const lf::axiom_t &ax) const
+float basic_distance_provider_t::operator()(const lf::axiom_t &ax) const
+{
+    return param_to_basic_distance(ax.func.param());
+}
+
+
+float basic_distance_provider_t::operator()(const lf::axiom_view_t &ax) const
+{
+    return param_to_basic_distance(ax.param());
+}
+
+
+/** Returns the cost written in the parameter of an axiom as distance. */
+static float param_to_cost_based_distance(const std::string &param)
 {
-    const std::string &param = ax.func.param();
     float out(-1.0f);
     _sscanf(param.substr(1).c_str(), "%f", &out);
     return out;
 }
 
+
+float cost_based_distance_provider_t::operator()(const lf::axiom_t &ax) const
+{
+    return param_to_cost_based_distance(ax.func.param());
+}
+
+
+float cost_based_distance_provider_t::operator()(const lf::axiom_view_t &ax) const
+{
+    return param_to_cost_based_distance(ax.param());
+}
+
 }
 
 
@@ -2069,7 +2988,8 @@ generator_t::operator() (phillip_main_t *ph) const
 
 
 basic_category_table_t::basic_category_table_t(int max_depth, float dist_scale)
-    : m_max_depth(max_depth), m_distance_scale(dist_scale)
+    : m_sources(NULL), m_entries(NULL), m_num_sources(0),
+      m_max_depth(max_depth), m_distance_scale(dist_scale)
 {
     assert(m_distance_scale > 0.0f);
 }
@@ -2120,7 +3040,13 @@ void basic_category_table_t::prepare_query(const kb::knowledge_base_t *base)
     m_prefix = base->filename();
     m_state = STATE_QUERY;
 
-    read(filename());
+    auto sec = base->find_section(".category.dat");
+    if (sec.first != NULL)
+        read(sec.first, sec.second);
+    else if (m_map.open(filename()))
+        read(m_map.data(), m_map.size());
+    else
+        util::print_error_fmt("Cannot open %s.", filename().c_str());
 }
 
 
@@ -2141,24 +3067,37 @@ float basic_category_table_t::get(arity_id_t a1, arity_id_t a2) const
 {
     assert(a1 != INVALID_ARITY_ID and a2 != INVALID_ARITY_ID);
 
-    auto found1 = m_table.find(a1);
-    if (found1 != m_table.end())
-    {
-        auto found2 = found1->second.find(a2);
-        if (found2 != found1->second.end())
-            return found2->second;
-    }
+    auto range = find(a1);
+    const entry_t *found = std::lower_bound(
+        range.first, range.second, a2,
+        [](const entry_t &e, arity_id_t a) { return e.arity < a; });
 
-    return -1.0f;
+    return (found != range.second and found->arity == a2) ? found->distance : -1.0f;
 }
 
 
 void basic_category_table_t::gets(
     const arity_id_t &a1, hash_map<arity_id_t, float> *out) const
 {
-    auto find = m_table.find(a1);
-    if (find != m_table.end())
-        out->insert(find->second.begin(), find->second.end());
+    auto range = find(a1);
+    for (const entry_t *e = range.first; e != range.second; ++e)
+        out->insert(std::make_pair((arity_id_t)e->arity, e->distance));
+}
+
+
+std::pair<const basic_category_table_t::entry_t*, const basic_category_table_t::entry_t*>
+basic_category_table_t::find(arity_id_t a1) const
+{
+    const source_t *end = m_sources + m_num_sources;
+    const source_t *found = std::lower_bound(
+        m_sources, end, a1,
+        [](const source_t &s, arity_id_t a) { return s.arity < a; });
+
+    if (found != end and found->arity == a1)
+        return std::make_pair(
+        m_entries + found->begin, m_entries + found->begin + found->num);
+    else
+        return std::make_pair((const entry_t*)NULL, (const entry_t*)NULL);
 }
 
 
@@ -2204,143 +3143,205 @@ void basic_category_table_t::finalize()
     }
 
     m_table.clear();
+    m_sources_buf.clear();
+    m_entries_buf.clear();
+    m_sources = NULL;
+    m_entries = NULL;
+    m_num_sources = 0;
+    m_map.close();
     m_state = STATE_NULL;
 }
 
 
 void basic_category_table_t::combinate()
 {
-    const float max_dist = knowledge_base_t::get_max_distance();
-    
-    auto search = [this](arity_id_t a1, arity_id_t a2) -> float
-    {
-        auto found1 = m_table.find(a1);
-        if (found1 != m_table.end())
-        {
-            auto found2 = found1->second.find(a2);
-            if (found2 != found1->second.end())
-                return found2->second;
-        }
-        return -1.0f;
-    };
-    
-    std::function<void(arity_id_t, arity_id_t, float, int)> walk =
-        [&, this](arity_id_t a1, arity_id_t a2, float dist, int depth)
+    IF_VERBOSE_1("Constructing category-table...");
+    IF_VERBOSE_3(util::format("    max-distance = %.2f", knowledge_base_t::get_max_distance()));
+    IF_VERBOSE_3(util::format("    max-depth = %d", m_max_depth));
+    IF_VERBOSE_3(util::format("    distance-scale = %.2f", m_distance_scale));
+
+    std::vector<arity_id_t> sources;
+    for (const auto &p : m_table)
+        sources.push_back(p.first);
+    std::sort(sources.begin(), sources.end());
+
+    /* EACH SOURCE IS PROCESSED INDEPENDENTLY, SO THAT THREADS SHARE NOTHING BUT m_table,
+     * WHICH IS READ-ONLY HERE. */
+    std::vector<std::vector<entry_t> > results(sources.size());
+    std::vector<std::thread> worker;
+    std::atomic<int> processed(0);
+    int num_thread = std::max<int>(1,
+        std::min<int>(sources.size(),
+        std::min<int>(knowledge_base_t::get_thread_num_for_rm(),
+        std::thread::hardware_concurrency())));
+
+    for (int th_id = 0; th_id < num_thread; ++th_id)
     {
-        if (m_max_depth >= 0 and depth >= m_max_depth)
-            return;
-        
-        for (auto p : m_table.at(a2))
+        worker.emplace_back([&](int th_id)
         {
-            if (p.first != a1)
+            for (size_t i = th_id; i < sources.size(); i += num_thread)
             {
-                float d_new = dist + p.second;
-                float d_old = search(a1, p.first);
+                combinate(sources[i], &results[i]);
 
-                if (d_old < 0.0 or d_new < d_old)
-                if (max_dist < 0.0 or d_new < max_dist)
+                int n = ++processed;
+                if (th_id == 0 and phillip_main_t::verbose() >= VERBOSE_1)
                 {
-                    m_table[a1][p.first] = d_new;
-                    walk(a1, p.first, d_new, depth + 1);
+                    float rate = 100.0f * n / sources.size();
+                    std::cerr << "Processed " << n << " elements [" << rate << "%]\r";
                 }
             }
-        }
-    };
+        }, th_id);
+    }
+    for (auto &t : worker) t.join();
 
-    IF_VERBOSE_1("Constructing category-table...");
-    IF_VERBOSE_3(util::format("    max-distance = %.2f", max_dist));
-    IF_VERBOSE_3(util::format("    max-depth = %d", m_max_depth));
-    IF_VERBOSE_3(util::format("    distance-scale = %.2f", m_distance_scale));
+    m_sources_buf.clear();
+    m_entries_buf.clear();
 
-    int n(0);
-    for (auto p1 : m_table)
+    for (size_t i = 0; i < sources.size(); ++i)
     {
-        for (auto p2 : p1.second)
-            walk(p1.first, p2.first, p2.second, 1);
+        if (results[i].empty()) continue;
+
+        source_t src;
+        src.arity = static_cast<unsigned int>(sources[i]);
+        src.begin = m_entries_buf.size();
+        src.num = static_cast<unsigned int>(results[i].size());
 
-        float rate = 100.0f * (++n) / m_table.size();
-        if (n % 10 == 0 and phillip_main_t::verbose() >= VERBOSE_1)
-            std::cerr << "Processed " << n << " elements [" << rate << "%]\r";
+        m_sources_buf.push_back(src);
+        m_entries_buf.insert(m_entries_buf.end(), results[i].begin(), results[i].end());
+        std::vector<entry_t>().swap(results[i]);
     }
-    
+
+    m_sources = m_sources_buf.empty() ? NULL : &m_sources_buf[0];
+    m_entries = m_entries_buf.empty() ? NULL : &m_entries_buf[0];
+    m_num_sources = m_sources_buf.size();
+
     IF_VERBOSE_1("Completed category-table construction.");
 }
 
 
-void basic_category_table_t::write(const std::string &filename) const
+void basic_category_table_t::combinate(arity_id_t src, std::vector<entry_t> *out) const
 {
-    std::ofstream fout(
-        filename, std::ios::out | std::ios::trunc | std::ios::binary);
+    const float max_dist = knowledge_base_t::get_max_distance();
 
-    if (fout.bad())
-    {
-        util::print_error_fmt("Cannot open %s.", filename.c_str());
-        return;
-    }
+    /** A state of search, which is (distance, depth, arity). */
+    typedef std::tuple<float, int, arity_id_t> state_t;
+    std::priority_queue<state_t, std::vector<state_t>, std::greater<state_t> > queue;
 
-    size_t num1 = m_table.size();
-    fout.write((char*)&num1, sizeof(size_t));
-    
-    IF_VERBOSE_4("Writing basic-category-table.");
+    /* THE SMALLEST DEPTH ON WHICH EACH ARITY HAS BEEN POPPED.
+     * SINCE STATES ARE POPPED IN ASCENDING ORDER OF DISTANCE,
+     * A STATE WHICH IS NOT SHALLOWER THAN THIS CANNOT LEAD TO SHORTER DISTANCES. */
+    hash_map<arity_id_t, int> depths;
+    hash_map<arity_id_t, float> dists;
 
-    size_t num(0);
-    for (auto p1 : m_table)
+    queue.push(state_t(0.0f, 0, src));
+
+    while (not queue.empty())
     {
-        size_t num2 = p1.second.size();
-        fout.write((char*)&p1.first, sizeof(arity_id_t));
-        fout.write((char*)&num2, sizeof(size_t));
+        float dist = std::get<0>(queue.top());
+        int depth = std::get<1>(queue.top());
+        arity_id_t a = std::get<2>(queue.top());
+        queue.pop();
+
+        auto found = depths.find(a);
+        if (found != depths.end() and found->second <= depth) continue;
+        depths[a] = depth;
+
+        if (a != src and dists.count(a) == 0)
+            dists[a] = dist;
+
+        // DIRECT EDGES ARE ALWAYS FOLLOWED, LIKE THE ONES GIVEN BY AXIOMS.
+        if (depth > 0 and m_max_depth >= 0 and depth >= m_max_depth) continue;
+
+        auto edges = m_table.find(a);
+        if (edges == m_table.end()) continue;
 
-        for (auto p2 : p1.second)
+        for (const auto &e : edges->second)
         {
-            fout.write((char*)&p2.first, sizeof(arity_id_t));
-            fout.write((char*)&p2.second, sizeof(float));
-            ++num;
+            if (e.first == src) continue;
+
+            float d_new = dist + e.second;
+            if (depth > 0 and max_dist >= 0.0 and d_new >= max_dist) continue;
+
+            queue.push(state_t(d_new, depth + 1, e.first));
         }
     }
-    
-    IF_VERBOSE_4(util::format("    # of entities = %d", num));
+
+    out->reserve(dists.size());
+    for (const auto &p : dists)
+    {
+        entry_t e;
+        e.arity = static_cast<unsigned int>(p.first);
+        e.distance = p.second;
+        out->push_back(e);
+    }
+    std::sort(out->begin(), out->end(),
+        [](const entry_t &x, const entry_t &y) { return x.arity < y.arity; });
 }
 
 
-void basic_category_table_t::read(const std::string &filename)
+void basic_category_table_t::write(const std::string &filename) const
 {
-    std::ifstream fin(filename, std::ios::in | std::ios::binary);
-    size_t num1, num2, num(0);
-    arity_id_t id1, id2;
-    m_table.clear();
+    std::ofstream fout(
+        filename, std::ios::out | std::ios::trunc | std::ios::binary);
 
-    if (fin.bad())
+    if (not fout)
     {
         util::print_error_fmt("Cannot open %s.", filename.c_str());
         return;
     }
 
-    fin.read((char*)&num1, sizeof(size_t));
+    IF_VERBOSE_4("Writing basic-category-table.");
 
-    IF_VERBOSE_4("Reading basic-category-table.");
+    unsigned long long num_sources = m_num_sources;
+    unsigned long long num_entries = m_entries_buf.size();
 
-    for (int i = 0; i < num1; ++i)
-    {
-        fin.read((char*)&id1, sizeof(arity_id_t));
-        fin.read((char*)&num2, sizeof(size_t));
+    fout.write((const char*)&num_sources, sizeof(unsigned long long));
+    fout.write((const char*)&num_entries, sizeof(unsigned long long));
+    if (num_sources > 0)
+        fout.write((const char*)m_sources, sizeof(source_t) * num_sources);
+    if (num_entries > 0)
+        fout.write((const char*)m_entries, sizeof(entry_t) * num_entries);
+    
+    IF_VERBOSE_4(util::format("    # of entities = %d", (int)num_entries));
+}
 
-        for (int j = 0; j < num2; ++j)
-        {
-            float d;
-            fin.read((char*)&id2, sizeof(arity_id_t));
-            fin.read((char*)&d, sizeof(float));
-            m_table[id1][id2] = d;
-            ++num;
-        }
-    }
 
-    IF_VERBOSE_4(util::format("    # of entities = %d", num));
+void basic_category_table_t::read(const char *data, size_t size)
+{
+    unsigned long long num_sources, num_entries;
+    size_t n = sizeof(unsigned long long) * 2;
+
+    if (size < n)
+        throw phillip_exception_t("Broken file: " + filename());
+
+    std::memcpy(&num_sources, data, sizeof(unsigned long long));
+    std::memcpy(&num_entries, data + sizeof(unsigned long long), sizeof(unsigned long long));
+
+    m_sources = (const source_t*)(data + n);
+    n += sizeof(source_t) * num_sources;
+    m_entries = (const entry_t*)(data + n);
+    n += sizeof(entry_t) * num_entries;
+    m_num_sources = num_sources;
+
+    if (size < n)
+        throw phillip_exception_t("Broken file: " + filename());
+
+    IF_VERBOSE_4("Reading basic-category-table.");
+    IF_VERBOSE_4(util::format("    # of entities = %d", (int)num_entries));
 }
 
 
 }
 
 
+pattern_t::pattern_t(const arity_pattern_t &q, const std::string &bin, size_t hash)
+    : m_arities(std::get<0>(q)),
+      m_hard_terms(std::get<1>(q).begin(), std::get<1>(q).end()),
+      m_soft_indices(std::get<2>(q).begin(), std::get<2>(q).end()),
+      m_binary(bin), m_hash(hash)
+{}
+
+
 void query_to_binary(const arity_pattern_t &q, std::vector<char> *bin)
 {
     size_t size_expected =
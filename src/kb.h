@@ -4,10 +4,13 @@
 #include <fstream>
 #include <map>
 #include <set>
+#include <algorithm>
 #include <list>
 #include <string>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <ctime>
 
 #include "./define.h"
@@ -41,7 +44,8 @@ enum version_e
 {
     KB_VERSION_UNDERSPECIFIED,
     KB_VERSION_1, KB_VERSION_2, KB_VERSION_3, KB_VERSION_4, KB_VERSION_5,
-    KB_VERSION_6, KB_VERSION_7, KB_VERSION_8,
+    KB_VERSION_6, KB_VERSION_7, KB_VERSION_8, KB_VERSION_9, KB_VERSION_10,
+    KB_VERSION_11,
     NUM_OF_KB_VERSION_TYPES
 };
 
@@ -54,6 +58,11 @@ public:
     virtual ~distance_provider_t() {}
     virtual float operator() (const lf::axiom_t &ax) const = 0;
 
+    /** Returns the distance of the axiom given as a view.
+     *  Override this to avoid decoding the axiom. */
+    virtual float operator() (const lf::axiom_view_t &ax) const
+    { return (*this)(ax.to_axiom()); }
+
     virtual std::string repr() const = 0;
 };
 
@@ -101,9 +110,9 @@ public:
     unification_postponement_t(
         arity_id_t arity, const std::vector<char> &args,
         small_size_t num_for_partial_indispensability);
-    unification_postponement_t(std::ifstream *fi);
+    unification_postponement_t(std::istream *fi);
 
-    void write(std::ofstream *fo) const;
+    void write(std::ostream *fo) const;
 
     arity_id_t arity_id() const { return m_arity; }
     bool do_postpone(const pg::proof_graph_t*, index_t n1, index_t n2) const;
@@ -116,6 +125,31 @@ private:
 };
 
 
+/** An immutable and flat representation of an arity pattern.
+ *  It holds the binary which is used as the key in the KB,
+ *  and the hash of the binary.
+ *  Instances are interned by knowledge_base_t and are referred by pattern_id_t. */
+class pattern_t
+{
+public:
+    pattern_t(const arity_pattern_t &q, const std::string &bin, size_t hash);
+
+    inline const std::vector<arity_id_t>& arities() const { return m_arities; }
+    inline const std::vector<std::pair<term_pos_t, term_pos_t> >& hard_terms() const { return m_hard_terms; }
+    inline const std::vector<small_size_t>& soft_unifiable_literal_indices() const { return m_soft_indices; }
+
+    inline const std::string& binary() const { return m_binary; }
+    inline size_t hash() const { return m_hash; }
+
+private:
+    std::vector<arity_id_t> m_arities;
+    std::vector<std::pair<term_pos_t, term_pos_t> > m_hard_terms;
+    std::vector<small_size_t> m_soft_indices;
+    std::string m_binary;
+    size_t m_hash;
+};
+
+
 /** A class of knowledge-base. */
 class knowledge_base_t
 {
@@ -123,8 +157,17 @@ public:
     static knowledge_base_t* instance();
     static void setup(
         std::string filename, float max_distance,
-        int thread_num_for_rm, bool do_disable_stop_word);
+        int thread_num_for_rm, bool do_disable_stop_word,
+        int cache_size = 10000, int distance_cache_size = 262144);
     static inline float get_max_distance();
+    static inline int get_thread_num_for_rm() { return ms_thread_num_for_rm; }
+
+    /** Sets whether checksums of sections are verified
+     *  on opening a single-file KB. */
+    static void enable_container_verification() { ms_do_verify_container = true; }
+    static void disable_container_verification() { ms_do_verify_container = false; }
+    static void set_query_map_buffer_size(size_t size) { ms_query_map_buffer_size = size; }
+    static void set_max_interned_patterns(size_t size) { ms_max_interned_patterns = size; }
 
     ~knowledge_base_t();
 
@@ -138,28 +181,64 @@ public:
     /** Call this method on end of compiling or reading knowledge base. */
     void finalize();
 
+    /** An implication which has been validated and encoded in advance.
+     *  Making this does not touch the KB, so it can be done in parallel. */
+    struct implication_t
+    {
+        lf::logical_function_t func;
+        std::string name;
+        std::string binary; /// Binary data of func.
+        std::vector<arity_t> arities, lhs, rhs;
+        bool is_paraphrase;
+        bool is_valid;
+    };
+
+    /** Validates and encodes given implication. This method is thread-safe. */
+    static void encode_implication(
+        const lf::logical_function_t &f, const std::string &name, implication_t *out);
+
     axiom_id_t insert_implication(
         const lf::logical_function_t &f, const std::string &name);
+    axiom_id_t insert_implication(const implication_t &imp);
     void insert_inconsistency(const lf::logical_function_t &f);
     void insert_unification_postponement(const lf::logical_function_t &f);
     void insert_argument_set(const lf::logical_function_t &f);
     void assert_stop_word(const arity_t &arity);
 
     inline lf::axiom_t get_axiom(axiom_id_t id) const;
+
+    /** Returns a view of the axiom, which is not decoded. */
+    inline lf::axiom_view_t get_axiom_view(axiom_id_t id) const;
     inline std::list<axiom_id_t> search_axioms_with_rhs(const std::string &arity) const;
     inline std::list<axiom_id_t> search_axioms_with_lhs(const std::string &arity) const;
-    inline const std::list<std::pair<term_idx_t, term_idx_t> >*
+    inline util::array_view_t<std::pair<term_idx_t, term_idx_t> >
         search_inconsistent_terms(arity_id_t a1, arity_id_t a2) const;
     inline arity_id_t search_arity_id(const arity_t &arity) const;
-    inline const arity_t& search_arity(arity_id_t id) const;
+    inline arity_t search_arity(arity_id_t id) const;
     hash_set<axiom_id_t> search_axiom_group(axiom_id_t id) const;
     inline const unification_postponement_t* find_unification_postponement(arity_id_t arity) const;
     inline const unification_postponement_t* find_unification_postponement(const arity_t &arity) const;
     argument_set_id_t search_argument_set_id(const std::string &arity, int term_idx) const;
-    void search_arity_patterns(arity_id_t arity, std::list<arity_pattern_t> *out) const;
+    void search_arity_patterns(arity_id_t arity, std::vector<pattern_id_t> *out) const;
     void search_axioms_with_arity_pattern(
-        const arity_pattern_t &query,
-        std::list<std::pair<axiom_id_t, bool> > *out) const;
+        pattern_id_t query, std::list<std::pair<axiom_id_t, bool> > *out) const;
+
+    /** Returns the pattern of given id, which is given by search_arity_patterns.
+     *  The reference is valid while the pattern_scope_t it was got in lives. */
+    inline const pattern_t& pattern(pattern_id_t id) const;
+
+    /** A scope in which ids of interned patterns are valid.
+     *  Patterns must be searched only inside a scope.
+     *  If the intern table exceeds its limit, it is cleared together with
+     *  the caches of pattern ids when the first scope opens after no scope is open. */
+    class pattern_scope_t
+    {
+    public:
+        pattern_scope_t(const knowledge_base_t *base);
+        ~pattern_scope_t();
+    private:
+        const knowledge_base_t *m_base;
+    };
 
     void set_distance_provider(const std::string &key, phillip_main_t *ph = NULL);
     void set_category_table(const std::string &key, phillip_main_t *ph = NULL);
@@ -169,9 +248,18 @@ public:
      *  If these arities are not reachable, then return -1. */
     float get_distance(
         const std::string &arity1, const std::string &arity2) const;
+    float get_distance(arity_id_t arity1, arity_id_t arity2) const;
+
+    /** Gets distances from arity to each of goals at once.
+     *  The i-th element of out is the distance to goals[i],
+     *  which is -1 if they are not reachable. */
+    void get_distances(
+        arity_id_t arity, const std::vector<arity_id_t> &goals,
+        std::vector<float> *out) const;
 
     /** Returns distance between arity1 and arity2 with distance-provider. */
     inline float get_distance(const lf::axiom_t &axiom) const;
+    inline float get_distance(const lf::axiom_view_t &axiom) const;
     inline float get_distance(axiom_id_t id) const;
 
     const category_table_t* category_table() const { return m_category_table.instance; }
@@ -184,6 +272,15 @@ public:
     inline int num_of_axioms() const;
     inline const hash_set<std::string>& stop_words() const;
 
+    /** Returns a new stream to read the database file of given suffix.
+     *  If the KB has been packed into a single file,
+     *  the stream reads the corresponding section on memory. */
+    std::istream* open_database(const std::string &suffix) const;
+
+    /** Returns the section of given suffix in the single-file KB.
+     *  Returns (NULL, 0) if the KB has not been packed. */
+    std::pair<const char*, size_t> find_section(const std::string &suffix) const;
+
     inline void clear_distance_cache();
 
 private:
@@ -195,10 +292,18 @@ private:
 
         void prepare_compile();
         void prepare_query();
+
+        /** Prepares for reading axioms from given memory blocks,
+         *  which must be alive until finalize() is called. */
+        void prepare_query(const char *idx, size_t idx_size, const char *dat);
         void finalize();
 
         void put(const std::string &name, const lf::logical_function_t &func);
+
+        /** Appends an axiom whose logical function has been encoded already. */
+        void put(const std::string &name, const std::string &binary);
         lf::axiom_t get(axiom_id_t id) const;
+        lf::axiom_view_t get_view(axiom_id_t id) const;
         inline bool is_writable() const;
         inline bool is_readable() const;
         inline int num_axioms() const { return m_num_compiled_axioms; }
@@ -212,41 +317,84 @@ private:
         static std::mutex ms_mutex;
         std::string m_filename;
         std::ofstream *m_fo_idx, *m_fo_dat;
-        std::ifstream *m_fi_idx, *m_fi_dat;
+        util::mapped_file_t m_map_idx, m_map_dat;
+        const char *m_idx, *m_dat;
         int m_num_compiled_axioms, m_num_unnamed_axioms;
         axiom_pos_t m_writing_pos;
     };
 
+    /** A class of database of arities.
+     *  On compiling, arities are held in a vector and a hash-map.
+     *  On querying, they are read from a compact binary on memory,
+     *  which consists of a string pool, an offset array, a minimal perfect hash
+     *  and flat sorted tables of unification-postponements and mutual-exclusions. */
     class arity_database_t
     {
     public:
+        typedef std::pair<term_idx_t, term_idx_t> term_pair_t;
+
         arity_database_t(const std::string &filename);
 
         void clear();
-        void read();
         void write() const;
 
+        void prepare_query();
+
+        /** Prepares for reading arities from given memory block,
+         *  which must be alive until clear() is called. */
+        void prepare_query(const char *data, size_t size);
+
         inline arity_id_t add(const arity_t&);
         inline void add_unification_postponement(const unification_postponement_t &unipp);
         void add_mutual_exclusion(const literal_t &l1, const literal_t &l2);
 
+        /** Returns arities added on compiling. */
         inline const std::vector<arity_t>& arities() const;
+
+        inline size_t size() const;
         inline arity_id_t arity2id(const arity_t&) const;
-        inline const arity_t& id2arity(arity_id_t) const;
+        inline arity_t id2arity(arity_id_t) const;
         inline const unification_postponement_t*
             find_unification_postponement(arity_id_t) const;
-        inline const std::list<std::pair<term_idx_t, term_idx_t> >*
+        util::array_view_t<term_pair_t>
             find_inconsistent_terms(arity_id_t, arity_id_t) const;
 
     private:
+        struct header_t
+        {
+            unsigned long long num_arities, num_buckets, blob_size;
+            unsigned long long num_unipps, unipp_size;
+            unsigned long long num_muexs, num_muex_pairs;
+        };
+
+        struct muex_t
+        {
+            unsigned long long arity1, arity2;
+            unsigned int begin, end;
+        };
+
+        static unsigned long long hash(
+            const char *str, size_t len, unsigned long long seed);
+        arity_id_t search_perfect_hash(const arity_t&) const;
+
         std::string m_filename;
 
+        /** Members used on compiling. */
         std::vector<arity_t> m_arities;
         hash_map<arity_t, arity_id_t> m_arity2id;
-
         hash_map<arity_id_t, unification_postponement_t> m_unification_postponements;
         hash_map<arity_id_t, hash_map<arity_id_t,
-            std::list<std::pair<term_idx_t, term_idx_t> > > > m_mutual_exclusions;
+            std::list<term_pair_t> > > m_mutual_exclusions;
+
+        /** Members used on querying. */
+        util::mapped_file_t m_map;
+        const header_t *m_header;
+        const unsigned long long *m_offsets;
+        const unsigned int *m_displacements, *m_slots;
+        const char *m_blob;
+        const muex_t *m_muexs;
+        const term_pair_t *m_muex_pairs;
+        std::vector<unification_postponement_t> m_unipps;
     };
 
     /** A class of reachable-matrix for all predicate pairs. */
@@ -257,12 +405,22 @@ private:
         ~reachable_matrix_t();
         void prepare_compile();
         void prepare_query();
+
+        /** Prepares for reading the matrix from given stream.
+         *  This takes the ownership of the stream. */
+        void prepare_query(std::istream *fin);
         void finalize();
 
         void put(size_t idx1, const hash_map<size_t, float> &dist);
         float get(size_t idx1, size_t idx2) const;
         hash_set<float> get(size_t idx) const;
 
+        /** Gets distances between idx1 and each of idx2s.
+         *  The row of idx1 is read only once. */
+        void gets(
+            size_t idx1, const std::vector<size_t> &idx2s,
+            std::vector<float> *out) const;
+
         inline bool is_writable() const;
         inline bool is_readable() const;
 
@@ -271,10 +429,40 @@ private:
         static std::mutex ms_mutex;
         std::string   m_filename;
         std::ofstream *m_fout;
-        std::ifstream *m_fin;
+        std::istream  *m_fin;
         hash_map<size_t, pos_t> m_map_idx_to_pos;
     };
 
+    /** A cache of distances between arities,
+     *  which is a fixed-size hash table and is accessed without locking.
+     *  Each slot is guarded by a sequence number.
+     *  A reader treats a slot being written as a miss,
+     *  and a writer gives up a slot which another writer holds. */
+    class distance_cache_t
+    {
+    public:
+        distance_cache_t(size_t size);
+
+        bool get(arity_id_t a1, arity_id_t a2, float *out) const;
+        void put(arity_id_t a1, arity_id_t a2, float dist);
+        void clear();
+
+    private:
+        struct entry_t
+        {
+            std::atomic<unsigned> seq;
+            std::atomic<unsigned long long> key;
+            std::atomic<float> value;
+        };
+
+        /** Returns the key of given pair, or 0 if it cannot be cached. */
+        static inline unsigned long long to_key(arity_id_t a1, arity_id_t a2);
+        inline entry_t& slot(unsigned long long key) const;
+
+        std::unique_ptr<entry_t[]> m_entries;
+        size_t m_mask;
+    };
+
     enum kb_state_e { STATE_NULL, STATE_COMPILE, STATE_QUERY };
 
     knowledge_base_t(const std::string &filename);
@@ -282,6 +470,14 @@ private:
     void write_config() const;
     void read_config();
 
+    /** Packs all database files into a single file of "<filename>.kb".
+     *  Each section is aligned to a page and has its checksum. */
+    void write_container() const;
+
+    /** Maps "<filename>.kb" on memory if it exists.
+     *  Returns whether the container has been opened. */
+    bool read_container();
+
     /** Outputs m_group_to_axioms to m_cdb_axiom_group. */
     void insert_axiom_group_to_cdb();
     void insert_argument_set_to_cdb();
@@ -318,8 +514,17 @@ private:
     static std::string ms_filename;
     static float ms_max_distance;
     static int ms_thread_num_for_rm;
+
+    /** The total size in bytes of buffers on creating arity patterns.
+     *  Exceeding buffers are spilled to temporary files. */
+    static size_t ms_query_map_buffer_size;
+
+    /** The number of interned patterns over which the table is cleared. */
+    static size_t ms_max_interned_patterns;
     static bool ms_do_disable_stop_word;
-    static std::mutex ms_mutex_for_cache;
+    static int ms_cache_size;
+    static int ms_distance_cache_size;
+    static bool ms_do_verify_container;
     static std::mutex ms_mutex_for_rm;
 
     kb_state_e m_state;
@@ -333,6 +538,10 @@ private:
     arity_database_t m_arity_db;
     reachable_matrix_t m_rm;
 
+    /** The single-file KB and its sections, which are keyed by suffixes. */
+    util::mapped_file_t m_container;
+    hash_map<std::string, std::pair<const char*, size_t> > m_sections;
+
     hash_map<size_t, hash_map<size_t, float> > m_partial_reachable_matrix;
 
     /** A set of arities of stop-words.
@@ -361,7 +570,26 @@ private:
         std::string key;
     } m_category_table;
 
-    mutable hash_map<size_t, hash_map<size_t, float> > m_cache_distance;
+    /** A cache of get_distance, which is shared among observations. */
+    mutable distance_cache_t m_cache_distance;
+
+    /** Returns the id of given pattern, interning it if it is new.
+     *  This method is thread-safe. */
+    pattern_id_t intern_pattern(const arity_pattern_t &q, const std::string &bin) const;
+
+    /** Caches of results of search_arity_patterns and
+     *  search_axioms_with_arity_pattern, which are shared among observations. */
+    mutable util::lru_cache_t<arity_id_t, std::vector<pattern_id_t> > m_cache_arity_patterns;
+    mutable util::lru_cache_t<pattern_id_t, std::list<std::pair<axiom_id_t, bool> > > m_cache_pattern_to_ids;
+
+    /** Interned patterns and their ids, which are grouped by hashes. */
+    mutable std::deque<pattern_t> m_patterns;
+    mutable hash_map<size_t, std::vector<pattern_id_t> > m_pattern_ids;
+    mutable std::mutex m_mutex_for_patterns;
+
+    /** The number of open pattern_scope_t. */
+    mutable int m_num_pattern_scopes;
+    mutable std::condition_variable m_cv_for_patterns;
 };
 
 
@@ -379,6 +607,7 @@ public:
     };
     
     virtual float operator() (const lf::axiom_t&) const;
+    virtual float operator() (const lf::axiom_view_t&) const;
     virtual std::string repr() const { return "Basic"; };
 };
 
@@ -393,6 +622,7 @@ public:
     };
     
     virtual float operator()(const lf::axiom_t&) const;
+    virtual float operator()(const lf::axiom_view_t&) const;
     virtual std::string repr() const { return "CostBased"; }
 };
 
@@ -429,7 +659,11 @@ public:
 };
 
 
-/** A class of basic category-table. */
+/** A class of basic category-table.
+ *  On compiling, the direct edges given by axioms are held in a hash-map
+ *  and are combinated into the closure on finalizing.
+ *  On querying, the closure is read from a compact table on memory,
+ *  which is sorted by sources and destinations and is searched by binary-search. */
 class basic_category_table_t : public category_table_t
 {
 public:
@@ -454,15 +688,49 @@ public:
     virtual void finalize() override;
 
 protected:
+    /** An element of the table. */
+    struct entry_t
+    {
+        unsigned int arity;
+        float distance;
+    };
+
+    /** Elements from a source are m_entries[begin, begin + num),
+     *  which are sorted by arities. */
+    struct source_t
+    {
+        unsigned long long begin;
+        unsigned int arity;
+        unsigned int num;
+    };
+
     void combinate();
+
+    /** Computes the distances from src to others by Dijkstra's algorithm,
+     *  which is bounded by m_max_depth and the max-distance of KB. */
+    void combinate(arity_id_t src, std::vector<entry_t> *out) const;
+
     void write(const std::string &filename) const;
-    void read(const std::string &filename);
+    void read(const char *data, size_t size);
+
+    /** Returns the elements from a1 or (NULL, NULL) if there is none. */
+    std::pair<const entry_t*, const entry_t*> find(arity_id_t a1) const;
 
     bool do_insert(const lf::logical_function_t&) const;
     std::string filename() const { return m_prefix + ".category.dat"; }
 
+    /** Direct edges inserted on compiling. */
     hash_map<arity_id_t, hash_map<arity_id_t, float> > m_table;
 
+    /** The closure made by combinate(). */
+    std::vector<source_t> m_sources_buf;
+    std::vector<entry_t> m_entries_buf;
+
+    const source_t *m_sources;
+    const entry_t *m_entries;
+    size_t m_num_sources;
+    util::mapped_file_t m_map;
+
     int m_max_depth;
     float m_distance_scale;
 };
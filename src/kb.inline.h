@@ -24,6 +24,15 @@ inline lf::axiom_t knowledge_base_t::get_axiom(axiom_id_t id) const
 }
 
 
+inline lf::axiom_view_t knowledge_base_t::get_axiom_view(axiom_id_t id) const
+{
+    if (id >= 0 and id < m_axioms.num_axioms())
+        return m_axioms.get_view(id);
+    else
+        return lf::axiom_view_t();
+}
+
+
 inline std::list<axiom_id_t> knowledge_base_t::
 search_axioms_with_rhs(const std::string &rhs) const
 {
@@ -40,7 +49,7 @@ search_axioms_with_lhs(const std::string &lhs) const
 }
 
 
-inline const std::list<std::pair<term_idx_t, term_idx_t> >* knowledge_base_t::
+inline util::array_view_t<std::pair<term_idx_t, term_idx_t> > knowledge_base_t::
 search_inconsistent_terms(arity_id_t a1, arity_id_t a2) const
 {
     return m_arity_db.find_inconsistent_terms(a1, a2);
@@ -53,9 +62,15 @@ inline float knowledge_base_t::get_distance(const lf::axiom_t &axiom) const
 }
 
 
+inline float knowledge_base_t::get_distance(const lf::axiom_view_t &axiom) const
+{
+    return (*m_distance_provider.instance)(axiom);
+}
+
+
 inline float knowledge_base_t::get_distance(axiom_id_t id) const
 {
-    return get_distance(get_axiom(id));
+    return get_distance(get_axiom_view(id));
 }
 
 
@@ -67,7 +82,7 @@ inline version_e knowledge_base_t::version() const
 
 inline bool knowledge_base_t::is_valid_version() const
 {
-    return m_version == KB_VERSION_8;
+    return m_version == KB_VERSION_11;
 }
 
 
@@ -103,23 +118,47 @@ inline const std::string& knowledge_base_t::filename() const
 
 inline void knowledge_base_t::clear_distance_cache()
 {
-    std::lock_guard<std::mutex> lock(ms_mutex_for_cache);
     m_cache_distance.clear();
 }
 
 
+inline unsigned long long knowledge_base_t::distance_cache_t::
+to_key(arity_id_t a1, arity_id_t a2)
+{
+    if (a1 > a2) std::swap(a1, a2);
+    if (a2 > 0xffffffffULL) return 0;
+    return (static_cast<unsigned long long>(a1) << 32) | a2;
+}
+
+
+inline knowledge_base_t::distance_cache_t::entry_t&
+knowledge_base_t::distance_cache_t::slot(unsigned long long key) const
+{
+    return m_entries[((key * 0x9E3779B97F4A7C15ULL) >> 32) & m_mask];
+}
+
+
 inline arity_id_t knowledge_base_t::search_arity_id(const arity_t &arity) const
 {
     return m_arity_db.arity2id(arity);
 }
 
 
-inline const arity_t& knowledge_base_t::search_arity(arity_id_t id) const
+inline arity_t knowledge_base_t::search_arity(arity_id_t id) const
 {
     return m_arity_db.id2arity(id);
 }
 
 
+inline const pattern_t& knowledge_base_t::pattern(pattern_id_t id) const
+{
+    /* THE DEQUE MAY BE EXTENDED BY ANOTHER THREAD,
+     * BUT REFERENCES TO ITS ELEMENTS ARE NOT INVALIDATED. */
+    std::lock_guard<std::mutex> lock(m_mutex_for_patterns);
+    return m_patterns[id];
+}
+
+
 const unification_postponement_t* knowledge_base_t::
 find_unification_postponement(arity_id_t arity) const
 {
@@ -142,7 +181,7 @@ inline bool knowledge_base_t::axioms_database_t::is_writable() const
 
 inline bool knowledge_base_t::axioms_database_t::is_readable() const
 {
-    return (m_fi_idx != NULL) and (m_fi_dat != NULL);
+    return (m_idx != NULL) and (m_dat != NULL);
 }
 
 
@@ -184,15 +223,30 @@ inline const std::vector<arity_t>& knowledge_base_t::arity_database_t::arities()
 }
 
 
+inline size_t knowledge_base_t::arity_database_t::size() const
+{
+    return (m_header != NULL) ? m_header->num_arities : m_arities.size();
+}
+
+
 inline arity_id_t knowledge_base_t::arity_database_t::arity2id(const arity_t &arity) const
 {
+    if (m_header != NULL)
+        return search_perfect_hash(arity);
+
     auto found = m_arity2id.find(arity);
     return (found != m_arity2id.end()) ? found->second : INVALID_ARITY_ID;
 }
 
 
-inline const arity_t& knowledge_base_t::arity_database_t::id2arity(arity_id_t id) const
+inline arity_t knowledge_base_t::arity_database_t::id2arity(arity_id_t id) const
 {
+    if (m_header != NULL)
+    {
+        if (id >= m_header->num_arities) return arity_t();
+        return arity_t(m_blob + m_offsets[id], m_offsets[id + 1] - m_offsets[id]);
+    }
+
     return (id < m_arities.size()) ? m_arities.at(id) : m_arities.front();    
 }
 
@@ -200,24 +254,10 @@ inline const arity_t& knowledge_base_t::arity_database_t::id2arity(arity_id_t id
 inline const unification_postponement_t*
 knowledge_base_t::arity_database_t::find_unification_postponement(arity_id_t id) const
 {
-    auto found = m_unification_postponements.find(id);
-    return (found != m_unification_postponements.end()) ? &found->second : NULL;
-}
-
-
-inline const std::list<std::pair<term_idx_t, term_idx_t> >*
-knowledge_base_t::arity_database_t::find_inconsistent_terms(arity_id_t a1, arity_id_t a2) const
-{
-    assert(a1 <= a2);
-
-    auto found1 = m_mutual_exclusions.find(a1);
-    if (found1 != m_mutual_exclusions.end())
-    {
-        auto found2 = found1->second.find(a2);
-        if (found2 != found1->second.end())
-            return &found2->second;
-    }
-    return NULL;
+    auto found = std::lower_bound(
+        m_unipps.begin(), m_unipps.end(), id,
+        [](const unification_postponement_t &u, arity_id_t id) { return u.arity_id() < id; });
+    return (found != m_unipps.end() and found->arity_id() == id) ? &(*found) : NULL;
 }
 
     
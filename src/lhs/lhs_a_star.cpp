@@ -13,15 +13,17 @@ namespace lhs
 
 
 a_star_based_enumerator_t::a_star_based_enumerator_t(
-    phillip_main_t *ptr, float max_dist, int max_depth)
+    phillip_main_t *ptr, float max_dist, int max_depth, bool do_bidirectional)
     : lhs_enumerator_t(ptr),
-      m_max_distance(max_dist), m_max_depth(max_depth)
+      m_max_distance(max_dist), m_max_depth(max_depth),
+      m_do_bidirectional(do_bidirectional)
 {}
 
 
 lhs_enumerator_t* a_star_based_enumerator_t::duplicate(phillip_main_t *ptr) const
 {
-    return new a_star_based_enumerator_t(ptr, m_max_distance, m_max_depth);
+    return new a_star_based_enumerator_t(
+        ptr, m_max_distance, m_max_depth, m_do_bidirectional);
 }
 
 
@@ -38,6 +40,18 @@ pg::proof_graph_t* a_star_based_enumerator_t::execute() const
     reachability_manager_t rm;
     initialize_reachability(graph, &rm);
 
+    // FOR BIDIRECTIONAL SEARCH:
+    //   reached : ARITIES WHICH HAVE BEEN REACHED FROM EACH OBSERVATION.
+    //   met : PAIRS OF OBSERVATIONS WHOSE FRONTIERS HAVE MET.
+    hash_map<pg::node_idx_t, hash_set<kb::arity_id_t> > reached;
+    util::pair_set_t<pg::node_idx_t> met;
+
+    if (m_do_bidirectional)
+    {
+        for (auto n : graph->observation_indices())
+            reached[n].insert(graph->node(n).arity_id());
+    }
+
     int max_chain_num = phillip()->param_int("max_chain_num", -1);
     int chain_num(0);
 
@@ -93,6 +107,46 @@ pg::proof_graph_t* a_star_based_enumerator_t::execute() const
                     }
                 }
 
+                if (m_do_bidirectional)
+                {
+                    for (auto &p : from2goals)
+                    {
+                        hash_set<kb::arity_id_t> &r = reached[p.first];
+                        for (auto n : nodes_new)
+                            r.insert(graph->node(n).arity_id());
+                    }
+
+                    // THE SEARCH FOR A PAIR IS FINISHED WHEN NEW NODES
+                    // REACH AN ARITY WHICH HAS BEEN REACHED FROM THE OTHER SIDE.
+                    for (auto &p : from2goals)
+                    {
+                        hash_set<pg::node_idx_t> &goals = p.second.second;
+
+                        for (auto g = goals.begin(); g != goals.end();)
+                        {
+                            const hash_set<kb::arity_id_t> &r = reached[*g];
+                            bool do_meet(false);
+
+                            for (auto n : nodes_new)
+                            if (r.count(graph->node(n).arity_id()) > 0)
+                            {
+                                do_meet = true;
+                                break;
+                            }
+
+                            if (do_meet)
+                            {
+                                IF_VERBOSE_FULL(util::format(
+                                    "Frontiers met: [%d] <-> [%d]", p.first, *g));
+                                met.insert(p.first, *g);
+                                g = goals.erase(g);
+                            }
+                            else
+                                ++g;
+                        }
+                    }
+                }
+
                 for (auto p : from2goals)
                 {
                     float dist = p.second.first + base->get_distance(axiom);
@@ -116,6 +170,8 @@ pg::proof_graph_t* a_star_based_enumerator_t::execute() const
             if (static_cast<pg::chain_candidate_t>(cand)
                 == static_cast<pg::chain_candidate_t>(*it))
                 it = rm.erase(it);
+            else if (m_do_bidirectional and met.count(it->node_from, it->node_to) > 0)
+                it = rm.erase(it);
             else
                 ++it;
         }
@@ -136,8 +192,7 @@ const pg::proof_graph_t *graph, reachability_manager_t *out) const
     for (auto n2 = obs.begin(); n2 != n1; ++n2)
     {
         float dist = kb->get_distance(
-            graph->node(*n1).literal().get_arity(),
-            graph->node(*n2).literal().get_arity());
+            graph->node(*n1).arity_id(), graph->node(*n2).arity_id());
 
         if (check_permissibility_of(dist))
         {
@@ -155,49 +210,59 @@ void a_star_based_enumerator_t::add_reachability(
 {    
     if (not check_permissibility_of(dist)) return;
 
-    hash_set<pg::node_idx_t> goals_filtered;
+    std::vector<pg::node_idx_t> goals_filtered;
+    std::vector<kb::arity_id_t> goal_arities;
     {
         arity_t arity_current = graph->node(current).arity();
         for (auto g : goals)
         if (graph->node(g).arity() != arity_current)
-            goals_filtered.insert(g);
+        {
+            goals_filtered.push_back(g);
+            goal_arities.push_back(graph->node(g).arity_id());
+        }
     }
     if (goals_filtered.empty()) return;
 
     pg::proof_graph_t::chain_candidate_generator_t gen(graph);
+    std::vector<float> dists, d_to(goals_filtered.size());
+
     for (gen.init(current); not gen.end(); gen.next())
     {
         for (auto ax : gen.axioms())
         {
-            lf::axiom_t axiom = kb::kb()->get_axiom(ax.first);
+            lf::axiom_view_t axiom = kb::kb()->get_axiom_view(ax.first);
             float d_from = dist + kb::kb()->get_distance(axiom);
             
             if (not check_permissibility_of(d_from)) continue;
+
+            // GETS DISTANCES FROM NEW LITERALS TO EACH GOAL.
+            const auto &lits = not kb::is_backward(ax) ? axiom.rhs() : axiom.lhs();
+            d_to.assign(goals_filtered.size(), -1.0f);
+
+            for (const auto &l : lits)
+            {
+                kb::kb()->get_distances(
+                    kb::kb()->search_arity_id(l.arity()), goal_arities, &dists);
+
+                for (size_t i = 0; i < dists.size(); ++i)
+                {
+                    float d = dists.at(i);
+                    if ((d_to[i] < 0.0f or d_to[i] > d)
+                        and check_permissibility_of(d))
+                        d_to[i] = d;
+                }
+            }
             
-            for (auto g : goals_filtered)
+            for (size_t i = 0; i < goals_filtered.size(); ++i)
             {
-                std::string arity_goal = graph->node(g).arity();
+                if (not check_permissibility_of(d_to.at(i))) continue;
+                if (not check_permissibility_of(d_from + d_to.at(i))) continue;
 
                 for (auto tar : gen.targets())
                 {
-                    auto lits = not kb::is_backward(ax) ?
-                        axiom.func.get_rhs() : axiom.func.get_lhs();
-                    float d_to(-1.0f);
-
-                    for (auto l : lits)
-                    {
-                        float d = kb::kb()->get_distance(l->get_arity(), arity_goal);
-                        if ((d_to < 0.0f or d_to > d)
-                            and check_permissibility_of(d))
-                            d_to = d;
-                    }
-
-                    if (not check_permissibility_of(d_to)) continue;
-                    if (not check_permissibility_of(d_from + d_to)) continue;
-
                     out->push(reachability_t(
                         pg::chain_candidate_t(tar, ax.first, !ax.second),
-                        start, g, d_from, d_to));
+                        start, goals_filtered.at(i), d_from, d_to.at(i)));
                 }
             }
         }
@@ -211,7 +276,8 @@ bool a_star_based_enumerator_t::is_available(std::list<std::string>*) const
 
 std::string a_star_based_enumerator_t::repr() const
 {
-    return "A*BasedEnumerator";
+    return m_do_bidirectional ?
+        "BidirectionalA*BasedEnumerator" : "A*BasedEnumerator";
 }
 
 
@@ -221,7 +287,8 @@ generator_t::operator()(phillip_main_t *ph) const
     return new lhs::a_star_based_enumerator_t(
         ph,
         ph->param_float("max_distance"),
-        ph->param_int("max_depth"));
+        ph->param_int("max_depth"),
+        ph->flag("a_star_bidirectional"));
 }
 
 
@@ -0,0 +1,199 @@
+/* -*- coding:utf-8 -*- */
+
+
+#include <ctime>
+#include <algorithm>
+#include "./lhs_enumerator.h"
+
+
+namespace phil
+{
+
+namespace lhs
+{
+
+
+beam_enumerator_t::beam_enumerator_t(
+    phillip_main_t *ptr, int max_depth, int beam_width, float max_dist)
+    : lhs_enumerator_t(ptr),
+      m_depth_max(max_depth), m_beam_width(beam_width), m_max_distance(max_dist)
+{}
+
+
+lhs_enumerator_t* beam_enumerator_t::duplicate(phillip_main_t *ptr) const
+{
+    return new beam_enumerator_t(ptr, m_depth_max, m_beam_width, m_max_distance);
+}
+
+
+pg::proof_graph_t* beam_enumerator_t::execute() const
+{
+    pg::proof_graph_t *graph =
+        new pg::proof_graph_t(phillip(), phillip()->get_input()->name);
+    pg::proof_graph_t::chain_candidate_generator_t gen(graph);
+
+    auto begin = std::chrono::system_clock::now();
+    add_observations(graph);
+
+    int max_chain_num = phillip()->param_int("max_chain_num", -1);
+    int chain_num(0);
+
+    for (int depth = 0; (m_depth_max < 0 or depth < m_depth_max); ++depth)
+    {
+        const hash_set<pg::node_idx_t>
+            *nodes = graph->search_nodes_with_depth(depth);
+        if (nodes == NULL) break;
+
+        std::set<pg::chain_candidate_t> candidates;
+
+        for (auto n : (*nodes))
+        {
+            for (gen.init(n); not gen.end(); gen.next())
+            {
+                for (auto ax : gen.axioms())
+                for (auto ns : gen.targets())
+                    candidates.insert(pg::chain_candidate_t(
+                    ns, ax.first, not kb::is_backward(ax)));
+            }
+        }
+
+        // SCORES CANDIDATES AND SORTS THEM IN ASCENDING ORDER.
+        std::vector<scored_candidate_t> scored;
+        hash_map<axiom_id_t, lf::axiom_view_t> views;
+
+        for (auto c : candidates)
+        {
+            auto found = views.find(c.axiom_id);
+            if (found == views.end())
+                found = views.insert(std::make_pair(
+                c.axiom_id, kb::kb()->get_axiom_view(c.axiom_id))).first;
+
+            float s = score(graph, c, found->second);
+            if (s >= 0.0f)
+                scored.push_back(std::make_pair(s, c));
+        }
+
+        std::stable_sort(
+            scored.begin(), scored.end(),
+            [](const scored_candidate_t &x, const scored_candidate_t &y)
+        { return x.first < y.first; });
+
+        if (scored.size() > static_cast<size_t>(m_beam_width))
+            scored.resize(m_beam_width);
+
+        IF_VERBOSE_FULL(util::format(
+            "Beam: depth = %d, candidates = %d, adopted = %d",
+            depth, candidates.size(), scored.size()));
+
+        // ONLY AXIOMS OF ADOPTED CANDIDATES ARE DECODED.
+        hash_map<axiom_id_t, lf::axiom_t> axioms;
+
+        for (auto p : scored)
+        {
+            const pg::chain_candidate_t &c = p.second;
+            auto found = axioms.find(c.axiom_id);
+            if (found == axioms.end())
+                found = axioms.insert(std::make_pair(
+                c.axiom_id, views.at(c.axiom_id).to_axiom())).first;
+            const lf::axiom_t &axiom = found->second;
+
+            pg::hypernode_idx_t to = c.is_forward ?
+                graph->forward_chain(c.nodes, axiom) :
+                graph->backward_chain(c.nodes, axiom);
+
+            if (to >= 0) ++chain_num;
+
+            // CHECK TIME-OUT
+            if (do_time_out(begin))
+            {
+                graph->timeout(true);
+                goto TIMED_OUT;
+            }
+
+            // CHECK CHAIN-LIMIT
+            if (max_chain_num > 0 and chain_num >= max_chain_num)
+                goto TIMED_OUT;
+        }
+    }
+
+    TIMED_OUT:
+
+    graph->post_process();
+    return graph;
+}
+
+
+float beam_enumerator_t::score(
+    const pg::proof_graph_t *graph,
+    const pg::chain_candidate_t &cand, const lf::axiom_view_t &axiom) const
+{
+    const kb::knowledge_base_t *base(kb::knowledge_base_t::instance());
+
+    float d_axiom = base->get_distance(axiom);
+    if (d_axiom < 0.0f) return -1.0f;
+
+    // OBSERVATIONS WHICH THE TARGET NODES HAVE COME FROM ARE NOT GOALS.
+    hash_set<pg::node_idx_t> excluded;
+    for (auto n : cand.nodes)
+    {
+        const hash_set<pg::node_idx_t> &anc = graph->node(n).ancestors();
+        excluded.insert(n);
+        excluded.insert(anc.begin(), anc.end());
+    }
+
+    std::vector<kb::arity_id_t> goals;
+    for (auto n : graph->observation_indices())
+    if (excluded.count(n) == 0)
+        goals.push_back(graph->node(n).arity_id());
+
+    const auto &lits = cand.is_forward ? axiom.rhs() : axiom.lhs();
+    std::vector<float> dists;
+    float d_goal(-1.0f);
+
+    for (const auto &l : lits)
+    {
+        base->get_distances(base->search_arity_id(l.arity()), goals, &dists);
+
+        for (auto d : dists)
+        if (d >= 0.0f and (d_goal < 0.0f or d < d_goal))
+            d_goal = d;
+    }
+
+    if (d_goal < 0.0f) return -1.0f;
+
+    float s = d_axiom + d_goal;
+    if (m_max_distance >= 0.0f and s > m_max_distance) return -1.0f;
+
+    return s;
+}
+
+
+bool beam_enumerator_t::is_available(std::list<std::string>*) const
+{ return true; }
+
+
+std::string beam_enumerator_t::repr() const
+{
+    return "BeamEnumerator";
+}
+
+
+lhs_enumerator_t* beam_enumerator_t::
+generator_t::operator()(phillip_main_t *ph) const
+{
+    int beam_width = ph->param_int("beam_width", 100);
+    if (beam_width <= 0)
+        throw phillip_exception_t(
+        "The parameter \"beam_width\" must be positive: " + ph->param("beam_width"));
+
+    return new lhs::beam_enumerator_t(
+        ph,
+        ph->param_int("max_depth"),
+        beam_width,
+        ph->param_float("max_distance"));
+}
+
+
+}
+
+}
@@ -2,6 +2,8 @@
 
 
 #include <ctime>
+#include <thread>
+#include <algorithm>
 #include "./lhs_enumerator.h"
 
 
@@ -13,14 +15,17 @@ namespace lhs
 
 
 depth_based_enumerator_t::depth_based_enumerator_t(
-    phillip_main_t *ptr, int max_depth)
-    : lhs_enumerator_t(ptr), m_depth_max(max_depth)
-{}
+    phillip_main_t *ptr, int max_depth, int thread_num)
+    : lhs_enumerator_t(ptr), m_depth_max(max_depth), m_thread_num(thread_num)
+{
+    if (m_thread_num <= 0)
+        m_thread_num = 1;
+}
 
 
 lhs_enumerator_t* depth_based_enumerator_t::duplicate(phillip_main_t *ptr) const
 {
-    return new depth_based_enumerator_t(ptr, m_depth_max);
+    return new depth_based_enumerator_t(ptr, m_depth_max, m_thread_num);
 }
 
 
@@ -29,7 +34,6 @@ pg::proof_graph_t* depth_based_enumerator_t::execute() const
     const kb::knowledge_base_t *base(kb::knowledge_base_t::instance());
     pg::proof_graph_t *graph =
         new pg::proof_graph_t(phillip(), phillip()->get_input()->name);
-    pg::proof_graph_t::chain_candidate_generator_t gen(graph);
 
     auto begin = std::chrono::system_clock::now();
     add_observations(graph);
@@ -43,22 +47,8 @@ pg::proof_graph_t* depth_based_enumerator_t::execute() const
             *nodes = graph->search_nodes_with_depth(depth);
         if (nodes == NULL) break;
 
-        hash_map<axiom_id_t, std::set<pg::chain_candidate_t>> candidates;
-
-        for (auto n : (*nodes))
-        {
-            for (gen.init(n); not gen.end(); gen.next())
-            {
-                for (auto ax : gen.axioms())
-                {
-                    std::set<pg::chain_candidate_t> &cands = candidates[ax.first];
-
-                    for (auto nodes : gen.targets())
-                        cands.insert(pg::chain_candidate_t(
-                        nodes, ax.first, not kb::is_backward(ax)));
-                }
-            }
-        }
+        candidates_map_t candidates;
+        enumerate_chain_candidates(graph, *nodes, &candidates);
 
         for (auto p : candidates)
         {
@@ -93,6 +83,62 @@ pg::proof_graph_t* depth_based_enumerator_t::execute() const
 }
 
 
+void depth_based_enumerator_t::enumerate_chain_candidates(
+    const pg::proof_graph_t *graph,
+    const hash_set<pg::node_idx_t> &nodes, candidates_map_t *out) const
+{
+    auto enumerate = [graph](
+        const std::vector<pg::node_idx_t> &targets, int begin, int step,
+        candidates_map_t *cands)
+    {
+        pg::proof_graph_t::chain_candidate_generator_t gen(graph);
+
+        for (size_t i = begin; i < targets.size(); i += step)
+        {
+            for (gen.init(targets.at(i)); not gen.end(); gen.next())
+            {
+                for (auto ax : gen.axioms())
+                {
+                    std::set<pg::chain_candidate_t> &set = (*cands)[ax.first];
+
+                    for (auto ns : gen.targets())
+                        set.insert(pg::chain_candidate_t(
+                        ns, ax.first, not kb::is_backward(ax)));
+                }
+            }
+        }
+    };
+
+    // TARGETS ARE SORTED SO THAT THE SERIAL AND PARALLEL MODES SEE THE SAME ORDER.
+    std::vector<pg::node_idx_t> targets(nodes.begin(), nodes.end());
+    std::sort(targets.begin(), targets.end());
+
+    int num_thread = std::min<int>(
+        targets.size(),
+        std::min<int>(m_thread_num, std::thread::hardware_concurrency()));
+
+    if (num_thread <= 1)
+    {
+        enumerate(targets, 0, 1, out);
+        return;
+    }
+
+    // THE GRAPH IS NOT MODIFIED WHILE CANDIDATES ARE ENUMERATED,
+    // SO EACH WORKER CAN READ IT WITHOUT LOCKING.
+    std::vector<candidates_map_t> results(num_thread);
+    std::vector<std::thread> worker;
+
+    for (int th_id = 0; th_id < num_thread; ++th_id)
+        worker.emplace_back(enumerate, std::cref(targets), th_id, num_thread, &results[th_id]);
+    for (auto &t : worker) t.join();
+
+    // MERGES THE RESULTS IN ORDER OF THREAD-ID.
+    for (auto &r : results)
+    for (auto &p : r)
+        (*out)[p.first].insert(p.second.begin(), p.second.end());
+}
+
+
 bool depth_based_enumerator_t::is_available(std::list<std::string>*) const
 { return true; }
 
@@ -106,7 +152,8 @@ std::string depth_based_enumerator_t::repr() const
 lhs_enumerator_t* depth_based_enumerator_t::
 generator_t::operator()(phillip_main_t *ph) const
 {
-    return new lhs::depth_based_enumerator_t(ph, ph->param_int("max_depth"));
+    return new lhs::depth_based_enumerator_t(
+        ph, ph->param_int("max_depth"), ph->param_int("lhs_thread_num", 1));
 }
 
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <set>
 #include <tuple>
 #include <queue>
@@ -26,7 +27,8 @@ public:
     };
 
     a_star_based_enumerator_t(
-        phillip_main_t *ptr, float max_dist, int max_depth = -1);
+        phillip_main_t *ptr, float max_dist, int max_depth = -1,
+        bool do_bidirectional = false);
     virtual lhs_enumerator_t* duplicate(phillip_main_t *ptr) const;
     virtual pg::proof_graph_t* execute() const;
     virtual bool is_available(std::list<std::string>*) const;
@@ -67,6 +69,10 @@ private:
 
     float m_max_distance;
     int m_max_depth;
+
+    /** If true, the search between each pair of observations is finished
+     *  when the frontiers from both of them meet. */
+    bool m_do_bidirectional;
 };
 
 
@@ -80,7 +86,8 @@ public:
         virtual lhs_enumerator_t* operator()(phillip_main_t*) const override;
     };
 
-    depth_based_enumerator_t(phillip_main_t *ptr, int max_depth);
+    depth_based_enumerator_t(
+        phillip_main_t *ptr, int max_depth, int thread_num = 1);
 
     virtual lhs_enumerator_t* duplicate(phillip_main_t *ptr) const;
     virtual pg::proof_graph_t* execute() const;
@@ -91,12 +98,61 @@ public:
 private:
     struct reachability_t { float distance, redundancy; };
     typedef hash_map<pg::node_idx_t, reachability_t > reachable_map_t;
+    /** Candidates grouped by axiom. Axioms are chained in order of their ids,
+     *  so the result does not depend on the number of threads. */
+    typedef std::map<axiom_id_t, std::set<pg::chain_candidate_t> > candidates_map_t;
+
+    /** Enumerates chain-candidates from given nodes into out.
+     *  When m_thread_num > 1, the nodes are shared among worker threads,
+     *  each of which has its own candidates and merges them into out. */
+    void enumerate_chain_candidates(
+        const pg::proof_graph_t *graph,
+        const hash_set<pg::node_idx_t> &nodes, candidates_map_t *out) const;
 
     int m_depth_max;
+    int m_thread_num;
 };
 
 
 
+/** A class to create latent-hypotheses-set of abduction.
+ *  Creation is limited with depth and,
+ *  at each depth, only the best K chain-candidates are adopted. */
+class beam_enumerator_t : public lhs_enumerator_t
+{
+public:
+    struct generator_t : public component_generator_t<lhs_enumerator_t>
+    {
+        virtual lhs_enumerator_t* operator()(phillip_main_t*) const override;
+    };
+
+    beam_enumerator_t(
+        phillip_main_t *ptr, int max_depth, int beam_width, float max_dist);
+
+    virtual lhs_enumerator_t* duplicate(phillip_main_t *ptr) const;
+    virtual pg::proof_graph_t* execute() const;
+    virtual bool is_available(std::list<std::string>*) const;
+    virtual std::string repr() const;
+    virtual bool do_keep_validity_on_timeout() const override { return true; }
+
+private:
+    typedef std::pair<float, pg::chain_candidate_t> scored_candidate_t;
+
+    /** Returns the score of given candidate, where lower is better.
+     *  The score is the sum of the distance of the axiom and
+     *  the distance from new literals to the nearest observation
+     *  which the candidate does not explain yet.
+     *  If no observation is reachable, returns a negative value. */
+    float score(
+        const pg::proof_graph_t *graph,
+        const pg::chain_candidate_t &cand, const lf::axiom_view_t &axiom) const;
+
+    int m_depth_max;
+    int m_beam_width;
+    float m_max_distance;
+};
+
+
 /* -------- INLINE METHODS -------- */
 
 
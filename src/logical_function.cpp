@@ -487,6 +487,118 @@ size_t logical_function_t::read_binary( const char *bin )
 }
 
 
+/** Appends the length and the content of str to out. */
+static void _serialize_string(const std::string &str, std::string *out)
+{
+    uint32_t len = static_cast<uint32_t>(str.size());
+    out->append(reinterpret_cast<const char*>(&len), sizeof(uint32_t));
+    out->append(str);
+}
+
+
+/** Throws if fewer than n bytes remain between bin and end. */
+static void _assert_remaining(const char *bin, const char *end, size_t n)
+{
+    if (bin > end or static_cast<size_t>(end - bin) < n)
+        throw phillip_exception_t("Binary data ended unexpectedly.");
+}
+
+
+static uint32_t _deserialize_uint32(const char *bin, const char *end)
+{
+    uint32_t num;
+    _assert_remaining(bin, end, sizeof(uint32_t));
+    std::memcpy(&num, bin, sizeof(uint32_t));
+    return num;
+}
+
+
+static size_t _deserialize_string(const char *bin, const char *end, std::string *out)
+{
+    uint32_t len = _deserialize_uint32(bin, end);
+    _assert_remaining(bin + sizeof(uint32_t), end, len);
+    out->assign(bin + sizeof(uint32_t), len);
+    return sizeof(uint32_t) + len;
+}
+
+
+void logical_function_t::serialize(std::string *out) const
+{
+    out->push_back(static_cast<char>(m_operator));
+
+    if (m_operator == OPR_LITERAL)
+    {
+        uint32_t num = static_cast<uint32_t>(m_literal.terms.size());
+
+        _serialize_string(m_literal.predicate, out);
+        out->append(reinterpret_cast<const char*>(&num), sizeof(uint32_t));
+        for (const auto &t : m_literal.terms)
+            _serialize_string(t.string(), out);
+        out->push_back(m_literal.truth ? 1 : 0);
+    }
+    else
+    {
+        uint32_t num = static_cast<uint32_t>(m_branches.size());
+        out->append(reinterpret_cast<const char*>(&num), sizeof(uint32_t));
+        for (const auto &br : m_branches)
+            br.serialize(out);
+    }
+
+    _serialize_string(m_param, out);
+}
+
+
+size_t logical_function_t::deserialize(const char *bin, const char *end)
+{
+    size_t n(0);
+    uint32_t num;
+    std::string s_buf;
+
+    _assert_remaining(bin, end, 1);
+    m_operator = static_cast<logical_operator_t>(bin[n++]);
+    m_literal = literal_t();
+    m_branches.clear();
+
+    if (m_operator < OPR_UNDERSPECIFIED or m_operator > OPR_UNIPP)
+        throw phillip_exception_t("Invalid operator occured.");
+
+    if (m_operator == OPR_LITERAL)
+    {
+        n += _deserialize_string(bin + n, end, &m_literal.predicate);
+
+        num = _deserialize_uint32(bin + n, end);
+        n += sizeof(uint32_t);
+
+        // EACH TERM NEEDS AT LEAST ITS LENGTH.
+        _assert_remaining(bin + n, end, static_cast<size_t>(num) * sizeof(uint32_t));
+        m_literal.terms.reserve(num);
+        for (uint32_t i = 0; i < num; ++i)
+        {
+            n += _deserialize_string(bin + n, end, &s_buf);
+            m_literal.terms.push_back(term_t(s_buf));
+        }
+
+        _assert_remaining(bin + n, end, 1);
+        m_literal.truth = (bin[n++] != 0);
+    }
+    else
+    {
+        num = _deserialize_uint32(bin + n, end);
+        n += sizeof(uint32_t);
+
+        // EACH BRANCH NEEDS AT LEAST ITS OPERATOR, A COUNT AND A PARAMETER.
+        _assert_remaining(bin + n, end, static_cast<size_t>(num) * (1 + sizeof(uint32_t) * 2));
+        m_branches.assign(num, logical_function_t());
+        for (uint32_t i = 0; i < num; ++i)
+            n += m_branches[i].deserialize(bin + n, end);
+    }
+
+    n += _deserialize_string(bin + n, end, &m_param);
+
+    return n;
+}
+
+
 void logical_function_t::print(
     std::string *p_out_str, bool f_colored ) const
 {
@@ -542,6 +654,149 @@ void logical_function_t::add_branch(const logical_function_t &lf)
 }
 
 
+void input_t::serialize(std::string *out) const
+{
+    _serialize_string(name, out);
+    obs.serialize(out);
+    req.serialize(out);
+    label.serialize(out);
+}
+
+
+size_t input_t::deserialize(const char *bin, const char *end)
+{
+    size_t n(0);
+    n += _deserialize_string(bin, end, &name);
+    n += obs.deserialize(bin + n, end);
+    n += req.deserialize(bin + n, end);
+    n += label.deserialize(bin + n, end);
+    return n;
+}
+
+
+std::string axiom_view_t::literal_view_t::term(int i) const
+{
+    const char *p = bin + 1 + static_cast<unsigned char>(bin[0]) + 1;
+    for (int j = 0; j < i; ++j)
+        p += 1 + static_cast<unsigned char>(p[0]);
+    return std::string(p + 1, static_cast<unsigned char>(p[0]));
+}
+
+
+std::string axiom_view_t::literal_view_t::arity() const
+{
+    std::string out(truth ? "" : "!");
+    out.append(bin + 1, static_cast<unsigned char>(bin[0]));
+    out += "/" + std::to_string(num_terms);
+    return out;
+}
+
+
+literal_t axiom_view_t::literal_view_t::to_literal() const
+{
+    literal_t out;
+    out.read_binary(bin);
+    return out;
+}
+
+
+axiom_view_t::axiom_view_t(axiom_id_t id, const char *bin)
+    : m_id(id), m_bin(bin), m_param(NULL)
+{
+    size_t n(0);
+    int opr;
+    n += util::binary_to_num(m_bin, &opr);
+    m_operator = static_cast<logical_operator_t>(opr);
+
+    switch (m_operator)
+    {
+    case OPR_IMPLICATION:
+    case OPR_PARAPHRASE:
+    case OPR_INCONSISTENT:
+        n = read_branch(n, &m_lhs);
+        n = read_branch(n, &m_rhs);
+        break;
+    case OPR_UNIPP:
+        n = read_branch(n, &m_lhs);
+        break;
+    default:
+        throw phillip_exception_t("Invalid operator occured.");
+    }
+
+    m_param = m_bin + n;
+}
+
+
+size_t axiom_view_t::read_branch(size_t n, std::vector<literal_view_t> *out) const
+{
+    int opr, num;
+    n += util::binary_to_num(m_bin + n, &opr);
+
+    switch (opr)
+    {
+    case OPR_LITERAL:
+    {
+        literal_view_t lit;
+        lit.bin = m_bin + n;
+        n += 1 + static_cast<unsigned char>(m_bin[n]);
+
+        n += util::binary_to_num(m_bin + n, &lit.num_terms);
+        for (int i = 0; i < lit.num_terms; ++i)
+            n += 1 + static_cast<unsigned char>(m_bin[n]);
+
+        n += util::binary_to_bool(m_bin + n, &lit.truth);
+        out->push_back(lit);
+        break;
+    }
+    case OPR_AND:
+    case OPR_OR:
+        n += util::binary_to_num(m_bin + n, &num);
+        for (int i = 0; i < num; ++i)
+            n = read_branch(n, out);
+        break;
+    case OPR_IMPLICATION:
+    case OPR_PARAPHRASE:
+    case OPR_INCONSISTENT:
+        n = read_branch(n, out);
+        n = read_branch(n, out);
+        break;
+    case OPR_UNIPP:
+        n = read_branch(n, out);
+        break;
+    default:
+        break;
+    }
+
+    // SKIPS THE PARAMETER
+    n += 1 + static_cast<unsigned char>(m_bin[n]);
+
+    return n;
+}
+
+
+std::string axiom_view_t::name() const
+{
+    std::string out;
+    util::binary_to_string(m_param + 1 + static_cast<unsigned char>(m_param[0]), &out);
+    return out;
+}
+
+
+axiom_t axiom_view_t::to_axiom() const
+{
+    axiom_t out;
+
+    if (not empty())
+    {
+        out.id = m_id;
+        size_t n = out.func.read_binary(m_bin);
+        util::binary_to_string(m_bin + n, &out.name);
+    }
+
+    return out;
+}
+
+
 void parse(const std::string &str, std::list<logical_function_t> *out)
 {
     std::stringstream ss(str);
@@ -87,6 +87,16 @@ public:
 
     size_t write_binary(char *bin) const;
     size_t read_binary(const char *bin);
+
+    /** Appends the binary of this to out.
+     *  Unlike write_binary, the number of branches and
+     *  the length of strings are not limited to 255. */
+    void serialize(std::string *out) const;
+
+    /** Restores this from the binary made by serialize.
+     *  Returns the number of bytes read.
+     *  Throws phillip_exception_t if the binary runs past end. */
+    size_t deserialize(const char *bin, const char *end);
     
     void print(std::string *p_out_str, bool f_colored = false) const;
 
@@ -111,6 +121,14 @@ private:
 
 struct input_t
 {
+    /** Appends the binary of this to out. */
+    void serialize(std::string *out) const;
+
+    /** Restores this from the binary made by serialize.
+     *  Returns the number of bytes read.
+     *  Throws phillip_exception_t if the binary runs past end. */
+    size_t deserialize(const char *bin, const char *end);
+
     std::string name;
     lf::logical_function_t obs;
     lf::logical_function_t req;
@@ -128,6 +146,56 @@ struct axiom_t
 };
 
 
+/** A light-weight view of an axiom on its compiled binary.
+ *  This reads arities, terms and the parameter of the axiom
+ *  directly from the binary, without decoding it into logical_function_t.
+ *  The binary must not be released while the view is used. */
+class axiom_view_t
+{
+public:
+    /** A view of a literal in the binary. */
+    struct literal_view_t
+    {
+        inline std::string predicate() const;
+        std::string term(int i) const;
+        std::string arity() const;
+        literal_t to_literal() const;
+
+        const char *bin; /// The head of the binary of this literal.
+        int num_terms;
+        bool truth;
+    };
+
+    axiom_view_t()
+        : m_id(-1), m_operator(OPR_UNDERSPECIFIED), m_bin(NULL), m_param(NULL) {}
+    axiom_view_t(axiom_id_t id, const char *bin);
+
+    inline axiom_id_t id() const { return m_id; }
+    inline bool empty() const { return m_bin == NULL; }
+    inline bool is_operator(logical_operator_t opr) const { return m_operator == opr; }
+
+    /** Returns literals in the left-hand side and the right-hand side. */
+    inline const std::vector<literal_view_t>& lhs() const { return m_lhs; }
+    inline const std::vector<literal_view_t>& rhs() const { return m_rhs; }
+
+    inline std::string param() const;
+    std::string name() const;
+
+    /** Decodes the binary into an instance of axiom_t. */
+    axiom_t to_axiom() const;
+
+private:
+    size_t read_branch(size_t n, std::vector<literal_view_t> *out) const;
+
+    axiom_id_t m_id;
+    logical_operator_t m_operator;
+    const char *m_bin;
+
+    std::vector<literal_view_t> m_lhs, m_rhs;
+    const char *m_param; /// The head of the binary of the parameter.
+};
+
+
 /** Parses given string as S-expression and returns the result of parsing. */
 void parse(const std::string &str, std::list<logical_function_t> *out);
 
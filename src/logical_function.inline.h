@@ -82,6 +82,18 @@ logical_function_t::get_all_literals() const
 }
 
 
+inline std::string axiom_view_t::literal_view_t::predicate() const
+{
+    return std::string(bin + 1, static_cast<unsigned char>(bin[0]));
+}
+
+
+inline std::string axiom_view_t::param() const
+{
+    return std::string(m_param + 1, static_cast<unsigned char>(m_param[0]));
+}
+
+
 }
 
 }
@@ -29,13 +29,17 @@ int main(int argc, char* argv[])
     {
         util::print_error(exception.what());
         if (exception.do_print_usage()) bin::print_usage();
+        return 1;
     }
 #ifdef USE_GUROBI
     catch (const GRBException &exception)
     {
         util::print_error("Gurobi-exception was thrown:");
         util::print_error("  -> " + exception.getMessage());
+        return 1;
     }
 #endif      
 #endif
+
+    return 0;
 }
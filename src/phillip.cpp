@@ -33,6 +33,8 @@ phillip_main_t::~phillip_main_t()
     if (m_input != NULL) delete m_input;
     if (m_lhs != NULL)   delete m_lhs;
     if (m_ilp != NULL)   delete m_ilp;
+
+    close_output_streams();
 }
 
 
@@ -48,27 +50,43 @@ phillip_main_t* phillip_main_t::duplicate() const
     out->m_timeout_lhs = m_timeout_lhs;
     out->m_timeout_ilp = m_timeout_ilp;
     out->m_timeout_sol = m_timeout_sol;
+    out->m_timeout_all = m_timeout_all;
 
     return out;
 }
 
 
-std::ofstream* _open_file(const std::string &path, std::ios::openmode mode)
+std::ostream* phillip_main_t::output_stream(
+    const std::string &path, std::ios::openmode mode) const
 {
-    if (not path.empty())
-    {
-        util::mkdir(util::get_directory_name(path));
+    if (path.empty()) return NULL;
 
-        std::ofstream *fo = new std::ofstream(path.c_str(), mode);
-        if (fo->good())
-            return fo;
-        else
-        {
-            util::print_error_fmt("Cannot open file: \"%s\"", path.c_str());
-            delete fo;
-        }
+    auto found = m_output_streams.find(path);
+    if (found != m_output_streams.end())
+        return found->second;
+
+    util::mkdir(util::get_directory_name(path));
+
+    std::ofstream *fo = new std::ofstream(path.c_str(), mode);
+    if (fo->good())
+    {
+        m_output_streams[path] = fo;
+        return fo;
+    }
+    else
+    {
+        util::print_error_fmt("Cannot open file: \"%s\"", path.c_str());
+        delete fo;
+        return NULL;
     }
-    return NULL;
+}
+
+
+void phillip_main_t::close_output_streams() const
+{
+    for (auto it = m_output_streams.begin(); it != m_output_streams.end(); ++it)
+        delete it->second;
+    m_output_streams.clear();
 }
 
 
@@ -85,12 +103,17 @@ void phillip_main_t::infer(const lf::input_t &input)
 
     m_time_for_infer = util::duration_time(begin);
 
-    std::ofstream *fo(NULL);
-    if ((fo = _open_file(param("path_out"), std::ios::out | std::ios::app)) != NULL)
+    write_solutions(m_sol);
+}
+
+
+void phillip_main_t::write_solutions(const std::vector<ilp::ilp_solution_t> &sols) const
+{
+    std::ostream *os(output_stream(param("path_out")));
+    if (os != NULL)
     {
-        for (auto sol = m_sol.begin(); sol != m_sol.end(); ++sol)
-            sol->print_graph(fo);
-        delete fo;
+        for (auto sol = sols.begin(); sol != sols.end(); ++sol)
+            sol->print_graph(os, output_format());
     }
 }
 
@@ -136,16 +159,18 @@ void phillip_main_t::learn(const lf::input_t &input)
 
     m_time_for_learn = util::duration_time(begin);
 
-    std::ofstream *fo(NULL);
-    if ((fo = _open_file(param("path_out"), std::ios::out | std::ios::app)) != NULL)
+    std::ostream *os(output_stream(param("path_out")));
+    if (os != NULL)
     {
         if (not flag("omit_proof_graph_from_xml"))
         {
-            m_sol.front().print_graph(fo);
-            m_sol_gold.front().print_graph(fo);
+            m_sol.front().print_graph(os, output_format());
+            m_sol_gold.front().print_graph(os, output_format());
         }
-        elem.print(fo);
-        delete fo;
+
+        /* THE RESULT OF TRAINING IS WRITTEN ONLY IN XML. */
+        if (output_format() == ilp::OUTPUT_XML)
+            elem.print(os);
     }
 }
 
@@ -158,8 +183,13 @@ void phillip_main_t::execute_enumerator(
 
     if ((*out_lhs) != NULL) delete m_lhs;
 
+    m_cancellation.start(get_time_limit(m_timeout_lhs, 0.0f));
+
     auto begin = std::chrono::system_clock::now();
-    (*out_lhs) = m_lhs_enumerator->execute();
+    {
+        kb::knowledge_base_t::pattern_scope_t scope(kb::kb());
+        (*out_lhs) = m_lhs_enumerator->execute();
+    }
     (*out_time) = util::duration_time(begin);
 
     IF_VERBOSE_2(
@@ -169,13 +199,9 @@ void phillip_main_t::execute_enumerator(
 
     if (not path_out_xml.empty())
     {       
-        std::ios::openmode mode = std::ios::out | std::ios::app;
-        std::ofstream *fo = _open_file(path_out_xml, mode);
-        if (fo != NULL)
-        {
-            m_lhs->print(fo);
-            delete fo;
-        }
+        std::ostream *os = output_stream(path_out_xml);
+        if (os != NULL)
+            m_lhs->print(os);
     }
 }
 
@@ -186,6 +212,8 @@ void phillip_main_t::execute_convertor(
 {
     IF_VERBOSE_2("Converting LHS into linear-programming-problems...");
 
+    m_cancellation.start(get_time_limit(m_timeout_ilp, get_time_for_lhs()));
+
     auto begin = std::chrono::system_clock::now();
     (*out_ilp) = m_ilp_convertor->execute();
     (*out_time) = util::duration_time(begin);
@@ -197,13 +225,9 @@ void phillip_main_t::execute_convertor(
 
     if (not path_out_xml.empty())
     {
-        std::ios::openmode mode = std::ios::out | std::ios::app;
-        std::ofstream *fo = _open_file(path_out_xml, mode);
-        if (fo != NULL)
-        {
-            m_ilp->print(fo);
-            delete fo;
-        }
+        std::ostream *os = output_stream(path_out_xml);
+        if (os != NULL)
+            m_ilp->print(os);
     }
 }
 
@@ -215,6 +239,9 @@ void phillip_main_t::execute_solver(
 {
     IF_VERBOSE_2("Solving...");
 
+    m_cancellation.start(get_time_limit(
+        m_timeout_sol, get_time_for_lhs() + get_time_for_ilp()));
+
     auto begin = std::chrono::system_clock::now();
     m_ilp_solver->execute(out_sols);
     (*out_time) = util::duration_time(begin);
@@ -223,18 +250,35 @@ void phillip_main_t::execute_solver(
 
     if (not path_out_xml.empty())
     {
-        std::ios::openmode mode = std::ios::out | std::ios::app;
-        std::ofstream *fo = _open_file(path_out_xml, mode);
-        if (fo != NULL)
+        std::ostream *os = output_stream(path_out_xml);
+        if (os != NULL)
         {
             for (auto sol = m_sol.begin(); sol != m_sol.end(); ++sol)
-                sol->print(fo);
-            delete fo;
+                sol->print(os);
         }
     }
 }
 
 
+duration_time_t phillip_main_t::get_time_limit(
+    const util::timeout_t &timeout, duration_time_t passed) const
+{
+    duration_time_t out(-1.0f);
+
+    if (not timeout.empty())
+        out = timeout.get();
+
+    if (not m_timeout_all.empty())
+    {
+        // IF THE WHOLE TIME HAS BEEN USED UP, THE STAGE STOPS IMMEDIATELY.
+        duration_time_t rest = std::max(m_timeout_all.get() - passed, 1e-6f);
+        if (out < 0.0f or rest < out) out = rest;
+    }
+
+    return out;
+}
+
+
 void phillip_main_t::write_header() const
 {
     auto write = [this](std::ostream *os)
@@ -311,16 +355,35 @@ void phillip_main_t::write_header() const
         (*os) << "</configure>" << std::endl;
     };
 
+    hash_set<std::string> written;
     auto f_write = [&](const std::string &key)
     {
-        std::ofstream *fo(NULL);
-        if ((fo = _open_file(param(key), (std::ios::out | std::ios::trunc))) != NULL)
-        {
-            write(fo);
-            delete fo;
-        }
+        if (not written.insert(param(key)).second) return;
+
+        std::ostream *os = output_stream(param(key), (std::ios::out | std::ios::trunc));
+        if (os != NULL)
+            write(os);
     };
 
+    /* THE OUTPUT IN JSONL OR BINARY HAS NO XML HEADER. */
+    switch (output_format())
+    {
+    case ilp::OUTPUT_JSONL:
+        written.insert(param("path_out"));
+        output_stream(param("path_out"), (std::ios::out | std::ios::trunc));
+        break;
+    case ilp::OUTPUT_BINARY:
+    {
+        written.insert(param("path_out"));
+        std::ostream *os = output_stream(
+            param("path_out"), (std::ios::out | std::ios::trunc | std::ios::binary));
+        if (os != NULL)
+            ilp::ilp_problem_t::write_solution_header(os);
+        break;
+    }
+    default: break;
+    }
+
     f_write("path_lhs_out");
     f_write("path_ilp_out");
     f_write("path_sol_out");
@@ -335,21 +398,190 @@ void phillip_main_t::write_footer() const
     {
         (*os) << "</phillip>" << std::endl;
     };
+    hash_set<std::string> written;
     auto f_write = [&](const std::string &key)
     {
-        std::ofstream *fo(NULL);
-        if ((fo = _open_file(param(key), (std::ios::out | std::ios::app))) != NULL)
-        {
-            write(fo);
-            delete fo;
-        }
+        if (not written.insert(param(key)).second) return;
+
+        std::ostream *os = output_stream(param(key));
+        if (os != NULL)
+            write(os);
     };
 
+    if (output_format() != ilp::OUTPUT_XML)
+        written.insert(param("path_out"));
+
     f_write("path_lhs_out");
     f_write("path_ilp_out");
     f_write("path_sol_out");
     f_write("path_out");
     write(&std::cout);
+
+    close_output_streams();
+}
+
+
+inference_pipeline_t::inference_pipeline_t(
+    phillip_main_t *master,
+    const std::function<void(const phillip_main_t*)> &on_done)
+    : m_master(master), m_on_done(on_done),
+      m_queue_lhs(master->param_int("pipeline_queue_size", 4)),
+      m_queue_ilp(master->param_int("pipeline_queue_size", 4)),
+      m_queue_sol(master->param_int("pipeline_queue_size", 4)),
+      m_num_pushed(0), m_num_finished(0), m_is_closed(false)
+{
+    auto get_thread_num = [master](const std::string &key) -> int
+    {
+        int n = master->param_int(key, 1);
+        return (n > 0) ? n : 1;
+    };
+
+    auto enumerate = [](item_t *item)
+    {
+        item->begin = std::chrono::system_clock::now();
+        item->phillip->execute_enumerator();
+    };
+    auto convert = [](item_t *item)
+    {
+        item->phillip->execute_convertor();
+    };
+    auto solve = [](item_t *item)
+    {
+        item->phillip->execute_solver();
+        item->phillip->m_time_for_infer = util::duration_time(item->begin);
+    };
+
+    for (int i = get_thread_num("pipeline_lhs_thread_num"); i > 0; --i)
+        m_workers_lhs.push_back(std::thread(
+        &inference_pipeline_t::run_stage, this, &m_queue_lhs, &m_queue_ilp, enumerate));
+    for (int i = get_thread_num("pipeline_ilp_thread_num"); i > 0; --i)
+        m_workers_ilp.push_back(std::thread(
+        &inference_pipeline_t::run_stage, this, &m_queue_ilp, &m_queue_sol, convert));
+    for (int i = get_thread_num("pipeline_sol_thread_num"); i > 0; --i)
+        m_workers_sol.push_back(std::thread(
+        &inference_pipeline_t::run_stage, this, &m_queue_sol,
+        (util::bounded_queue_t<item_t*>*)NULL, solve));
+}
+
+
+inference_pipeline_t::~inference_pipeline_t()
+{
+    close();
+}
+
+
+void inference_pipeline_t::push(const lf::input_t &input)
+{
+    if (m_is_closed)
+        throw phillip_exception_t("Cannot add an observation to a closed pipeline.");
+
+    item_t *item = new item_t();
+    item->index = m_num_pushed++;
+    item->is_failed = false;
+    item->phillip.reset(m_master->duplicate());
+
+    /* EACH DUPLICATE DOES NOT WRITE ANYTHING,
+     * BECAUSE THE RESULTS ARE WRITTEN BY THE MASTER IN THE ORDER OF INPUTS. */
+    item->phillip->erase_param("path_lhs_out");
+    item->phillip->erase_param("path_ilp_out");
+    item->phillip->erase_param("path_sol_out");
+    item->phillip->erase_param("path_out");
+
+    item->phillip->reset_for_inference();
+    item->phillip->set_input(input);
+
+    if (not m_queue_lhs.push(item))
+        delete item;
+}
+
+
+void inference_pipeline_t::close()
+{
+    if (m_is_closed) return;
+    m_is_closed = true;
+
+    /* EACH STAGE IS CLOSED AFTER ALL WORKERS OF THE PREVIOUS STAGE HAVE FINISHED. */
+    m_queue_lhs.close();
+    for (auto &t : m_workers_lhs) t.join();
+    m_queue_ilp.close();
+    for (auto &t : m_workers_ilp) t.join();
+    m_queue_sol.close();
+    for (auto &t : m_workers_sol) t.join();
+
+    for (auto it = m_done.begin(); it != m_done.end(); ++it)
+        delete it->second;
+    m_done.clear();
+}
+
+
+void inference_pipeline_t::run_stage(
+    util::bounded_queue_t<item_t*> *in, util::bounded_queue_t<item_t*> *out,
+    const std::function<void(item_t*)> &proc)
+{
+    for (item_t *item; in->pop(&item);)
+    {
+        if (not item->is_failed)
+        {
+            try
+            {
+                proc(item);
+            }
+            catch (const std::exception &e)
+            {
+                util::print_warning_fmt(
+                    "Some exception was caught and then the observation \"%s\" was skipped.",
+                    item->phillip->get_input()->name.c_str());
+                util::print_warning_fmt("  -> what(): %s", e.what());
+                item->is_failed = true;
+            }
+        }
+
+        if (out != NULL)
+            out->push(item);
+        else
+            finish(item);
+    }
+}
+
+
+void inference_pipeline_t::finish(item_t *item)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_done[item->index] = item;
+
+    for (auto it = m_done.find(m_num_finished); it != m_done.end();
+         it = m_done.find(++m_num_finished))
+    {
+        item_t *done = it->second;
+        m_done.erase(it);
+
+        if (not done->is_failed)
+        {
+            const phillip_main_t *ph = done->phillip.get();
+            std::ostream *os;
+
+            if (ph->m_lhs != NULL and
+                (os = m_master->output_stream(m_master->param("path_lhs_out"))) != NULL)
+                ph->m_lhs->print(os);
+
+            if (ph->m_ilp != NULL and
+                (os = m_master->output_stream(m_master->param("path_ilp_out"))) != NULL)
+                ph->m_ilp->print(os);
+
+            if ((os = m_master->output_stream(m_master->param("path_sol_out"))) != NULL)
+            {
+                for (auto sol = ph->m_sol.begin(); sol != ph->m_sol.end(); ++sol)
+                    sol->print(os);
+            }
+
+            m_master->write_solutions(ph->m_sol);
+
+            if (m_on_done)
+                m_on_done(ph);
+        }
+
+        delete done;
+    }
 }
 
 
@@ -3,8 +3,11 @@
 #pragma once
 
 #include <string>
+#include <fstream>
 #include <map>
 #include <chrono>
+#include <memory>
+#include <thread>
 
 #include "./kb.h"
 #include "./interface.h"
@@ -20,6 +23,7 @@ namespace phil
 class lhs_enumerator_t;
 class ilp_converter_t;
 class ilp_solver_t;
+class inference_pipeline_t;
 
 
 /** Main class of Phillip.
@@ -30,6 +34,8 @@ class ilp_solver_t;
  *   - Call infer() with input observation. */
 class phillip_main_t
 {
+    friend class inference_pipeline_t;
+
 public:
     static inline void set_verbose(int v);
     static inline const int verbose();
@@ -84,6 +90,14 @@ public:
     inline const util::timeout_t& timeout_sol() const { return m_timeout_sol; }
     inline const util::timeout_t& timeout_all() const { return m_timeout_all; }
 
+    /** Returns the token to stop the inference for current observation.
+     *  Components poll it in their loops. */
+    inline util::cancellation_token_t& cancellation() const { return m_cancellation; }
+
+    /** Stops the inference for current observation as soon as possible.
+     *  This can be called from another thread. */
+    inline void cancel() { m_cancellation.cancel(); }
+
     inline const hash_map<std::string, std::string>& params() const;
     inline const std::string& param(const std::string &key) const;
     inline int param_int(const std::string &key, int def = -1) const;
@@ -93,6 +107,10 @@ public:
     inline bool flag(const std::string &key) const;
     inline bool do_infer_pseudo_positive() const;
 
+    /** Returns the format of the output to param("path_out"),
+     *  which is given by param("output_format"). */
+    inline ilp::output_format_e output_format() const;
+
     inline float get_time_for_lhs()  const;
     inline float get_time_for_ilp()  const;
     inline float get_time_for_sol()  const;
@@ -107,9 +125,19 @@ public:
     inline bool check_validity() const;
     
     void write_header() const;
+
+    /** Writes the footer and closes the output files. */
     void write_footer() const;
 
+    /** Writes the solutions to param("path_out") in output_format(). */
+    void write_solutions(const std::vector<ilp::ilp_solution_t> &sols) const;
+
 protected:
+    /** Returns the time limit of a stage which starts after given seconds
+     *  from the beginning of the inference, or -1 if it has no limit. */
+    duration_time_t get_time_limit(
+        const util::timeout_t &timeout, duration_time_t passed) const;
+
     inline void reset_for_inference();
     inline void set_input(const lf::input_t&);
 
@@ -128,6 +156,15 @@ protected:
         duration_time_t *out_clock,
         const std::string &path_out_xml);
 
+    /** Returns the output stream to given path.
+     *  The file is opened at the first call and is kept open
+     *  until write_footer is called, so that each observation
+     *  does not need to reopen it. Returns NULL if path is empty. */
+    std::ostream* output_stream(
+        const std::string &path,
+        std::ios::openmode mode = (std::ios::out | std::ios::app)) const;
+    void close_output_streams() const;
+
 private:
     static int ms_verboseness;
 
@@ -140,10 +177,13 @@ private:
     hash_map<std::string, std::string> m_params;
     hash_set<std::string> m_flags;
     util::timeout_t m_timeout_lhs, m_timeout_ilp, m_timeout_sol, m_timeout_all;
+    mutable util::cancellation_token_t m_cancellation;
     
     hash_set<std::string> m_target_obs_names;
     hash_set<std::string> m_excluded_obs_names;
 
+    mutable hash_map<std::string, std::ofstream*> m_output_streams;
+
     // ---- PRODUCTS OF INFERENCE
     lf::input_t *m_input;
     pg::proof_graph_t *m_lhs;
@@ -161,6 +201,66 @@ private:
 };
 
 
+
+
+/** A class to infer observations in a pipeline.
+ *  LHS enumeration, ILP conversion and ILP solving are stages,
+ *  which are connected with bounded queues and run on their own threads,
+ *  so that an observation can be enumerated while the previous ones are
+ *  being converted or solved. Each observation is processed by a duplicate
+ *  of the master, and the results are written by the master in the order of inputs.
+ *  Unknown terms are numbered by a counter shared among observations, so their
+ *  names differ from those in sequential inference. Because transitive equalities
+ *  among unknown terms and the direction of unification edges depend on the order
+ *  of terms, the proof-graphs agree with sequential ones only in their
+ *  abductive edges, not in equality nodes or unification edges. */
+class inference_pipeline_t
+{
+public:
+    /** @param master  An instance whose setting is used for every observation.
+     *  @param on_done Is called for each observation in the order of inputs,
+     *                 after its results have been written. */
+    inference_pipeline_t(
+        phillip_main_t *master,
+        const std::function<void(const phillip_main_t*)> &on_done);
+    ~inference_pipeline_t();
+
+    /** Adds an observation. This blocks while the first queue is full. */
+    void push(const lf::input_t &input);
+
+    /** Waits for all observations added to be processed. */
+    void close();
+
+private:
+    struct item_t
+    {
+        size_t index;
+        std::unique_ptr<phillip_main_t> phillip;
+        std::chrono::system_clock::time_point begin;
+        bool is_failed;
+    };
+
+    /** Runs a stage, which pops items from in, processes them and pushes them to out. */
+    void run_stage(
+        util::bounded_queue_t<item_t*> *in, util::bounded_queue_t<item_t*> *out,
+        const std::function<void(item_t*)> &proc);
+
+    /** Writes the results of items which have been done, in the order of inputs. */
+    void finish(item_t *item);
+
+    phillip_main_t *m_master;
+    std::function<void(const phillip_main_t*)> m_on_done;
+
+    util::bounded_queue_t<item_t*> m_queue_lhs, m_queue_ilp, m_queue_sol;
+    std::vector<std::thread> m_workers_lhs, m_workers_ilp, m_workers_sol;
+
+    size_t m_num_pushed, m_num_finished;
+    std::map<size_t, item_t*> m_done;
+    std::mutex m_mutex;
+    bool m_is_closed;
+};
+
+
 }
 
 
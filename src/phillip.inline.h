@@ -193,6 +193,15 @@ inline bool phillip_main_t::do_infer_pseudo_positive() const
 }
 
 
+inline ilp::output_format_e phillip_main_t::output_format() const
+{
+    const std::string &fmt = param("output_format");
+    if (fmt == "jsonl") return ilp::OUTPUT_JSONL;
+    if (fmt == "bin")   return ilp::OUTPUT_BINARY;
+    return ilp::OUTPUT_XML;
+}
+
+
 inline float phillip_main_t::get_time_for_lhs()  const
 {
     return m_time_for_enumerate;
@@ -295,6 +304,7 @@ inline void phillip_main_t::reset_for_inference()
     m_time_for_learn = 0.0f;
     m_time_for_infer = 0.0f;
 
+    m_cancellation.reset();
     m_sol.clear();
 }
 
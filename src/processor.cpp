@@ -1,6 +1,9 @@
 /* -*- coding: utf-8 -*- */
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
 
 #include "./processor.h"
 #include "./phillip.h"
@@ -36,7 +39,7 @@ void parse_obs_t::process(const sexp::reader_t *reader)
 {
     const sexp::stack_t& stack(*reader->get_stack());
 
-    if (not stack.is_functor("O") or m_inputs == NULL)
+    if (not stack.is_functor("O"))
         return;
 
     /* SHOULD BE ROOT. */
@@ -64,14 +67,168 @@ void parse_obs_t::process(const sexp::reader_t *reader)
         _assert_syntax(data.req.is_valid_as_requirements(), (*reader), "Arguments of req are invalid.");
     }
 
-    m_inputs->push_back(data);
+    add(data);
 }
 
 
-void compile_kb_t::prepare()
+void parse_obs_t::add(const lf::input_t &data)
+{
+    if (m_inputs != NULL)
+        m_inputs->push_back(data);
+    else if (m_queue != NULL and not m_queue->push(data))
+        throw phillip_exception_t("Loading observations has been aborted.");
+}
+
+
+const char COMPILED_OBS_MAGIC[8] = { 'P', 'H', 'I', 'L', 'O', 'B', 'S', '\0' };
+const uint32_t COMPILED_OBS_VERSION = 1;
+const size_t COMPILED_OBS_HEADER_SIZE = 8 + sizeof(uint32_t) * 2 + sizeof(uint64_t);
+
+
+void compile_obs_t::prepare()
+{
+    uint32_t reserved(0);
+
+    m_num = 0;
+    m_fout.open(m_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+    if (not m_fout)
+        throw phillip_exception_t("Cannot open the file: " + m_path);
+
+    m_fout.write(COMPILED_OBS_MAGIC, 8);
+    m_fout.write((const char*)&COMPILED_OBS_VERSION, sizeof(uint32_t));
+    m_fout.write((const char*)&reserved, sizeof(uint32_t));
+    m_fout.write((const char*)&m_num, sizeof(uint64_t));
+}
+
+
+void compile_obs_t::add(const lf::input_t &data)
+{
+    m_buffer.clear();
+    data.serialize(&m_buffer);
+    m_fout.write(m_buffer.data(), m_buffer.size());
+    ++m_num;
+}
+
+
+void compile_obs_t::quit()
+{
+    // WRITES THE NUMBER OF OBSERVATIONS, WHICH IS UNKNOWN IN prepare().
+    m_fout.seekp(8 + sizeof(uint32_t) * 2);
+    m_fout.write((const char*)&m_num, sizeof(uint64_t));
+    m_fout.close();
+
+    util::print_console_fmt("    # of observations: %d", static_cast<int>(m_num));
+}
+
+
+bool compiled_obs_reader_t::is_compiled(const std::string &path)
+{
+    if (path == "-") return false;
+
+    char magic[8];
+    std::ifstream fin(path.c_str(), std::ios::in | std::ios::binary);
+    fin.read(magic, 8);
+
+    return fin.good() and std::memcmp(magic, COMPILED_OBS_MAGIC, 8) == 0;
+}
+
+
+compiled_obs_reader_t::compiled_obs_reader_t(const std::string &path)
+    : m_path(path), m_cur(NULL), m_end(NULL), m_num(0), m_num_read(0)
+{
+    uint32_t version;
+    uint64_t num;
+
+    if (not m_file.open(path))
+        throw phillip_exception_t("File not found: " + path);
+
+    if (m_file.size() < COMPILED_OBS_HEADER_SIZE or
+        std::memcmp(m_file.data(), COMPILED_OBS_MAGIC, 8) != 0)
+        throw phillip_exception_t("Invalid compiled observations: " + path);
+
+    std::memcpy(&version, m_file.data() + 8, sizeof(uint32_t));
+    if (version != COMPILED_OBS_VERSION)
+        throw phillip_exception_t(
+        "Unsupported version of compiled observations: " + path);
+
+    std::memcpy(&num, m_file.data() + 8 + sizeof(uint32_t) * 2, sizeof(uint64_t));
+    m_num = static_cast<size_t>(num);
+    m_cur = m_file.data() + COMPILED_OBS_HEADER_SIZE;
+    m_end = m_file.data() + m_file.size();
+}
+
+
+bool compiled_obs_reader_t::next(lf::input_t *out)
+{
+    if (m_num_read >= m_num)
+        return false;
+
+    try
+    {
+        if (m_cur >= m_end)
+            throw phillip_exception_t("No data is left.");
+        m_cur += out->deserialize(m_cur, m_end);
+    }
+    catch (const phillip_exception_t &e)
+    {
+        throw phillip_exception_t(util::format(
+            "Compiled observations are broken: %s (observation %lu of %lu): ",
+            m_path.c_str(), static_cast<unsigned long>(m_num_read + 1),
+            static_cast<unsigned long>(m_num)) + e.what());
+    }
+
+    ++m_num_read;
+    return true;
+}
+
+
+compile_kb_t::compile_kb_t(int thread_num)
+    : m_thread_num(thread_num), m_num_jobs(0), m_num_written(0),
+      m_is_closed(false), m_job(NULL)
 {}
 
 
+compile_kb_t::~compile_kb_t()
+{
+    // STOPS THE THREADS WHEN PROCESSING HAS BEEN ABORTED BY AN EXCEPTION.
+    if (m_writer.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_is_closed = true;
+            if (not m_error)
+                m_error = std::make_exception_ptr(phillip_exception_t("Aborted."));
+        }
+        m_cond_jobs.notify_all();
+
+        for (auto &th : m_workers)
+            th.join();
+
+        m_cond_results.notify_all();
+        m_writer.join();
+    }
+
+    delete m_job;
+    for (auto job : m_jobs) delete job;
+    for (auto p : m_results) delete p.second;
+}
+
+
+void compile_kb_t::prepare()
+{
+    if (m_thread_num <= 1) return;
+
+    m_num_jobs = m_num_written = 0;
+    m_is_closed = false;
+    m_error = nullptr;
+
+    for (int i = 0; i < m_thread_num; ++i)
+        m_workers.push_back(std::thread(&compile_kb_t::work, this));
+    m_writer = std::thread(&compile_kb_t::write, this);
+}
+
+
 void compile_kb_t::process( const sexp::reader_t *reader )
 {    
     const sexp::stack_t *stack(reader->get_stack());
@@ -120,45 +277,63 @@ void compile_kb_t::process( const sexp::reader_t *reader )
     if (idx_lf >= 0 or idx_para >= 0)
     {
         index_t idx = std::max(idx_lf, idx_para);
-        lf::logical_function_t func(*stack->children[idx]);
         _assert_syntax(
             (stack->children.at(idx)->children.size() >= 3), (*reader),
             "Function '=>' and '<=>' takes two arguments.");
         IF_VERBOSE_FULL(
             ((idx_lf >= 0) ? "Added implication: " : "Added paraphrase") +
             stack->to_string());
-        _kb->insert_implication(func, name);
+
+        if (m_thread_num > 1)
+            add_job(JOB_IMPLICATION, *stack->children[idx], name);
+        else
+            _kb->insert_implication(lf::logical_function_t(*stack->children[idx]), name);
     }
     else if (idx_inc >= 0)
     {
-        lf::logical_function_t func(*stack->children[idx_inc]);
         _assert_syntax(
             (stack->children.at(idx_inc)->children.size() >= 3), (*reader),
             "Function 'xor' takes two arguments.");
         IF_VERBOSE_FULL("Added inconsistency: " + stack->to_string());
-        _kb->insert_inconsistency(func);
+
+        if (m_thread_num > 1)
+            add_job(JOB_INCONSISTENCY, *stack->children[idx_inc], name);
+        else
+            _kb->insert_inconsistency(lf::logical_function_t(*stack->children[idx_inc]));
     }
     else if (idx_pp >= 0)
     {
-        lf::logical_function_t func(*stack->children[idx_pp]);
         _assert_syntax(
             (stack->children.at(idx_pp)->children.size() >= 2), (*reader),
             "Function 'unipp' takes one argument.");
         IF_VERBOSE_FULL("Added unification-postponement: " + stack->to_string());
-        _kb->insert_unification_postponement(func);
+
+        if (m_thread_num > 1)
+            add_job(JOB_UNIPP, *stack->children[idx_pp], name);
+        else
+            _kb->insert_unification_postponement(
+            lf::logical_function_t(*stack->children[idx_pp]));
     }
     else if (idx_as >= 0)
     {
-        lf::logical_function_t func(*stack->children[idx_as]);
-        if (phillip_main_t::verbose() == FULL_VERBOSE)
+        if (m_thread_num > 1)
         {
-            const std::vector<term_t> &terms = func.literal().terms;
-            std::string disp;
-            for (auto it = terms.begin(); it != terms.end(); ++it)
-                disp += (it != terms.begin() ? ", " : "") + it->string();
-            util::print_console("Added argument-set: {" + disp + "}");
+            IF_VERBOSE_FULL("Added argument-set: " + stack->to_string());
+            add_job(JOB_ARGSET, *stack->children[idx_as], name);
+        }
+        else
+        {
+            lf::logical_function_t func(*stack->children[idx_as]);
+            if (phillip_main_t::verbose() == FULL_VERBOSE)
+            {
+                const std::vector<term_t> &terms = func.literal().terms;
+                std::string disp;
+                for (auto it = terms.begin(); it != terms.end(); ++it)
+                    disp += (it != terms.begin() ? ", " : "") + it->string();
+                util::print_console("Added argument-set: {" + disp + "}");
+            }
+            _kb->insert_argument_set(func);
         }
-        _kb->insert_argument_set(func);
     }
     else if (idx_assert >= 0)
     {
@@ -182,7 +357,178 @@ void compile_kb_t::process( const sexp::reader_t *reader )
 
 
 void compile_kb_t::quit()
-{}
+{
+    if (m_thread_num <= 1) return;
+
+    flush_job();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_closed = true;
+    }
+    m_cond_jobs.notify_all();
+
+    for (auto &th : m_workers)
+        th.join();
+    m_workers.clear();
+
+    m_cond_results.notify_all();
+    m_writer.join();
+
+    if (m_error)
+        std::rethrow_exception(m_error);
+}
+
+
+void compile_kb_t::add_job(
+    job_type_e type, const sexp::stack_t &stack, const std::string &name)
+{
+    if (m_job == NULL)
+        m_job = new job_t;
+
+    // THE STACK IS COPIED, BECAUSE THE READER WILL CLEAR IT ON NEXT READING.
+    std::function<sexp::stack_t*(const sexp::stack_t&)> copy =
+        [&](const sexp::stack_t &s) -> sexp::stack_t*
+    {
+        m_job->pool.push_back(sexp::stack_t(s.type));
+        sexp::stack_t *out = &m_job->pool.back();
+        out->str = s.str;
+        for (auto c : s.children)
+            out->children.push_back(copy(*c));
+        return out;
+    };
+    m_job->items.push_back(std::make_tuple(type, name, copy(stack)));
+
+    if (m_job->items.size() >= 64)
+        flush_job();
+}
+
+
+void compile_kb_t::flush_job()
+{
+    if (m_job == NULL) return;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const size_t max_pending = 4 * m_thread_num;
+
+    // WAITS FOR THE WRITER SO THAT CHUNKS DO NOT PILE UP ON MEMORY.
+    m_cond_space.wait(lock, [&]()
+    { return (m_num_jobs - m_num_written < max_pending) or m_error; });
+
+    if (m_error)
+        delete m_job;
+    else
+    {
+        m_job->index = m_num_jobs++;
+        m_jobs.push_back(m_job);
+        m_cond_jobs.notify_one();
+    }
+
+    m_job = NULL;
+}
+
+
+void compile_kb_t::work()
+{
+    while (true)
+    {
+        job_t *job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_jobs.wait(lock, [this]() { return not m_jobs.empty() or m_is_closed; });
+
+            if (m_jobs.empty()) return;
+            job = m_jobs.front();
+            m_jobs.pop_front();
+        }
+
+        std::vector<result_t> *results = new std::vector<result_t>(job->items.size());
+
+        try
+        {
+            for (size_t i = 0; i < job->items.size(); ++i)
+            {
+                const auto &item = job->items.at(i);
+                result_t &res = results->at(i);
+
+                res.type = std::get<0>(item);
+                res.implication.is_valid = false;
+
+                if (res.type == JOB_IMPLICATION)
+                    kb::knowledge_base_t::encode_implication(
+                    lf::logical_function_t(*std::get<2>(item)),
+                    std::get<1>(item), &res.implication);
+                else
+                    res.func = lf::logical_function_t(*std::get<2>(item));
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (not m_error) m_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results[job->index] = results;
+        }
+        m_cond_results.notify_all();
+
+        delete job;
+    }
+}
+
+
+void compile_kb_t::write()
+{
+    kb::knowledge_base_t *_kb = kb::knowledge_base_t::instance();
+
+    while (true)
+    {
+        std::vector<result_t> *results;
+        bool has_error;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_results.wait(lock, [this]()
+            {
+                return
+                    m_results.count(m_num_written) > 0 or
+                    (m_is_closed and m_num_written == m_num_jobs);
+            });
+
+            auto found = m_results.find(m_num_written);
+            if (found == m_results.end()) return;
+
+            results = found->second;
+            m_results.erase(found);
+            has_error = static_cast<bool>(m_error);
+        }
+
+        if (not has_error)
+        {
+            for (const auto &res : (*results))
+            {
+                switch (res.type)
+                {
+                case JOB_IMPLICATION:
+                    _kb->insert_implication(res.implication); break;
+                case JOB_INCONSISTENCY:
+                    _kb->insert_inconsistency(res.func); break;
+                case JOB_UNIPP:
+                    _kb->insert_unification_postponement(res.func); break;
+                case JOB_ARGSET:
+                    _kb->insert_argument_set(res.func); break;
+                }
+            }
+        }
+        delete results;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_num_written;
+        }
+        m_cond_space.notify_all();
+    }
+}
 
 
 processor_t::~processor_t()
@@ -207,27 +553,26 @@ void processor_t::process( std::vector<std::string> inputs )
             
     for( auto it=inputs.begin(); it!=inputs.end(); ++it )
     {
-        std::istream *p_is( &std::cin );
-        std::ifstream file;
+        util::mapped_file_t mapped;
         size_t file_size(0);
         const std::string &input_path( *it );
         std::string filename;
         
         if( input_path != "-" )
         {
-            file.open( input_path.c_str() );
-            p_is = &file;
-
-            if (file.fail())
+            if (not mapped.open(input_path))
                 throw phillip_exception_t("File not found: " + input_path);
 
-            file_size = util::get_file_size(*p_is);
+            file_size = mapped.size();
             filename  = input_path.substr( input_path.rfind('/')+1 );
         }
         else
             filename = "stdin";
         
-        sexp::reader_t reader( *p_is, filename );
+        std::unique_ptr<sexp::reader_t> p_reader((input_path != "-") ?
+            new sexp::reader_t(mapped.data(), mapped.size(), filename) :
+            new sexp::reader_t(std::cin, filename));
+        sexp::reader_t &reader(*p_reader);
         hash_set<long> notified;
                 
         for( ; not reader.is_end(); reader.read() )
@@ -239,11 +584,11 @@ void processor_t::process( std::vector<std::string> inputs )
                 if( notified.count(progress) == 0 )
                 {
                     notified.insert(progress);
-                    std::cerr << util::time_stamp()
-                              << input_path << ":" << read_bytes
-                              << "/" << file_size
-                              << " bytes processed (" << progress << "%)."
-                              << std::endl;
+                    util::print_console(util::format(
+                        "%s:%lu/%lu bytes processed (%d%%).",
+                        input_path.c_str(),
+                        static_cast<unsigned long>(read_bytes),
+                        static_cast<unsigned long>(file_size), progress));
                 }
             }
 
@@ -253,8 +598,6 @@ void processor_t::process( std::vector<std::string> inputs )
             include( &reader );
         }
 
-        if( input_path != "-" ) file.close();
-
         if( reader.get_queue().size() != 1 )
         {
             std::string out = util::format(
@@ -4,8 +4,16 @@
 #define HENRY_PROCESSOR_H
 
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <tuple>
+#include <fstream>
+
 #include "./s_expression.h"
 #include "./logical_function.h"
+#include "./kb.h"
 
 namespace phil
 {
@@ -18,33 +26,133 @@ namespace proc
 class component_t
 {
 public:
+    virtual ~component_t() {}
     virtual void prepare() = 0;
     virtual void process( const sexp::reader_t* ) = 0;
     virtual void quit() = 0;
 };
 
 
-/** A class of component for parsing input to observations. */
+/** A class of component for parsing input to observations.
+ *  Observations are stored in a vector, or passed to the consumer one by one
+ *  through a queue. In the latter case, the parsing is aborted by an exception
+ *  when the queue has been closed. */
 class parse_obs_t : public component_t
 {
 public:
-    parse_obs_t( std::vector<lf::input_t> *ipt ) : m_inputs(ipt) {}
+    parse_obs_t( std::vector<lf::input_t> *ipt ) : m_inputs(ipt), m_queue(NULL) {}
+    parse_obs_t( util::bounded_queue_t<lf::input_t> *q ) : m_inputs(NULL), m_queue(q) {}
     virtual void prepare() {}
     virtual void process( const sexp::reader_t* );
     virtual void quit() {}
 
+protected:
+    parse_obs_t() : m_inputs(NULL), m_queue(NULL) {}
+
+    /** Is called for each observation parsed. */
+    virtual void add( const lf::input_t& );
+
 private:
     std::vector<lf::input_t> *m_inputs;
+    util::bounded_queue_t<lf::input_t> *m_queue;
+};
+
+
+/** A class of component for compiling observations into a binary file.
+ *  The compiled file can be given to inference mode instead of
+ *  the original input, which skips parsing of s-expressions. */
+class compile_obs_t : public parse_obs_t
+{
+public:
+    compile_obs_t( const std::string &path ) : m_path(path), m_num(0) {}
+    virtual void prepare();
+    virtual void quit();
+
+protected:
+    virtual void add( const lf::input_t& );
+
+private:
+    std::string m_path;
+    std::ofstream m_fout;
+    std::string m_buffer;
+    uint64_t m_num;
 };
 
 
-/** A class of component for compiling knowledge base. */
+/** A class to read observations from a file made by compile_obs_t.
+ *  The file is mapped on memory and observations are decoded one by one. */
+class compiled_obs_reader_t
+{
+public:
+    /** Returns whether given file is of compiled observations. */
+    static bool is_compiled( const std::string &path );
+
+    compiled_obs_reader_t( const std::string &path );
+
+    /** Decodes the next observation to out.
+     *  Returns false if all observations have been read.
+     *  Throws phillip_exception_t if the file ends before that. */
+    bool next( lf::input_t *out );
+
+    inline size_t size() const { return m_num; }
+
+private:
+    std::string m_path;
+    util::mapped_file_t m_file;
+    const char *m_cur, *m_end;
+    size_t m_num, m_num_read;
+};
+
+
+/** A class of component for compiling knowledge base.
+ *  If thread_num > 1, axioms are parsed and encoded by worker threads,
+ *  and then inserted to the knowledge base in the order of input by a writer thread. */
 class compile_kb_t : public component_t
 {
 public:
+    compile_kb_t(int thread_num = 1);
+    virtual ~compile_kb_t();
     virtual void prepare();
     virtual void process(const sexp::reader_t*);
     virtual void quit();
+
+private:
+    enum job_type_e { JOB_IMPLICATION, JOB_INCONSISTENCY, JOB_UNIPP, JOB_ARGSET };
+
+    /** A chunk of s-expressions to be parsed, which are copied from the reader. */
+    struct job_t
+    {
+        size_t index;
+        std::list<sexp::stack_t> pool;
+        std::vector<std::tuple<job_type_e, std::string, sexp::stack_t*> > items;
+    };
+
+    /** A result of parsing, which is inserted to KB by the writer. */
+    struct result_t
+    {
+        job_type_e type;
+        lf::logical_function_t func;
+        kb::knowledge_base_t::implication_t implication;
+    };
+
+    void add_job(job_type_e type, const sexp::stack_t &stack, const std::string &name);
+    void flush_job();
+    void work();
+    void write();
+
+    int m_thread_num;
+    size_t m_num_jobs, m_num_written;
+    bool m_is_closed;
+
+    job_t *m_job; /// The chunk being filled by the reader.
+    std::deque<job_t*> m_jobs;
+    std::map<size_t, std::vector<result_t>*> m_results;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_jobs, m_cond_results, m_cond_space;
+
+    std::vector<std::thread> m_workers;
+    std::thread m_writer;
+    std::exception_ptr m_error;
 };
 
 
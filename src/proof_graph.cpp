@@ -186,11 +186,11 @@ void proof_graph_t::chain_candidate_generator_t::init(node_idx_t idx)
 
     if (m_pivot >= 0)
     {
-        std::list<kb::arity_pattern_t> patterns;
+        std::vector<kb::pattern_id_t> patterns;
         kb::arity_id_t id_pivot = m_graph->node(m_pivot).arity_id();
 
         kb::kb()->search_arity_patterns(id_pivot, &patterns);
-        m_patterns.insert(patterns.begin(), patterns.end());
+        m_patterns.insert(m_patterns.end(), patterns.begin(), patterns.end());
 
         hash_map<kb::arity_id_t, float> soft_unifiable_arities;
 
@@ -201,8 +201,12 @@ void proof_graph_t::chain_candidate_generator_t::init(node_idx_t idx)
             p.second < m_graph->threshold_distance_for_soft_unifying())
         {
             kb::kb()->search_arity_patterns(p.first, &patterns);
-            m_patterns.insert(patterns.begin(), patterns.end());
+            m_patterns.insert(m_patterns.end(), patterns.begin(), patterns.end());
         }
+
+        std::sort(m_patterns.begin(), m_patterns.end());
+        m_patterns.erase(
+            std::unique(m_patterns.begin(), m_patterns.end()), m_patterns.end());
     }
 
     m_pt_iter = m_patterns.begin();
@@ -232,11 +236,12 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
 
     if (end()) return;
 
+    const kb::pattern_t &pattern = kb::kb()->pattern(*m_pt_iter);
+    const std::vector<kb::arity_id_t> &arities = pattern.arities();
     hash_map<kb::arity_id_t, hash_set<node_idx_t>> a2ns;
-    std::list<std::list<node_idx_t> > node_arrays;
 
     // CONSTRUCTS a2ns
-    for (auto a : kb::arities(*m_pt_iter))
+    for (auto a : arities)
     if (a2ns.count(a) == 0)
     {
         auto found = m_graph->search_nodes_with_arity(a);
@@ -245,9 +250,9 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
     }
 
     // EXPANDS a2ns WITH SOFT-UNIFIABLE NODES
-    for (auto i : kb::soft_unifiable_literal_indices(*m_pt_iter))
+    for (auto i : pattern.soft_unifiable_literal_indices())
     {
-        kb::arity_id_t a = kb::arities(*m_pt_iter).at(i);
+        kb::arity_id_t a = arities.at(i);
         hash_set<node_idx_t> ns;
 
         m_graph->enumerate_nodes_softly_unifiable(kb::kb()->search_arity(a), &ns);
@@ -258,22 +263,22 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
     // IF THERE IS A SLOT WHICH CANNOT BE FILLED, THEN ABORT.
     {
         hash_set<kb::arity_id_t> arity_set(
-            kb::arities(*m_pt_iter).begin(),
-            kb::arities(*m_pt_iter).end());
+            arities.begin(),
+            arities.end());
         if (a2ns.size() < arity_set.size()) return;
     }
 
     // CONSTRUCTS hard_term_satisfiers,
     // WHICH IS LISTS OF NODE-PAIR WHICH CAN SATISFY HARD-TERM CONSTRAINTS.
     hash_map<index_t, hash_map<index_t, std::pair<term_idx_t, term_idx_t>>> hard_terms;
-    for (auto p : kb::hard_terms(*m_pt_iter))
+    for (auto p : pattern.hard_terms())
         hard_terms[p.second.first][p.first.first] =
             std::make_pair(p.second.second, p.first.second);
 
     hash_set<index_t> slots_pivot;
-    for (index_t i = 0; i < kb::arities(*m_pt_iter).size(); ++i)
+    for (index_t i = 0; i < arities.size(); ++i)
     {
-        kb::arity_id_t id1 = kb::arities(*m_pt_iter).at(i);
+        kb::arity_id_t id1 = arities.at(i);
         kb::arity_id_t id2 = m_graph->node(m_pivot).arity_id();
 
         if (id1 == id2)
@@ -315,7 +320,7 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
             
             if (not do_violate_hard_term(nodes, i))
             {
-                if (i < kb::arities(*m_pt_iter).size() - 1)
+                if (i < arities.size() - 1)
                     routine_recursive(nodes, i + 1, i_pivot);
                 else
                     m_targets.push_back(*nodes);
@@ -324,7 +329,7 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
         else
         {
             const hash_set<node_idx_t> &ns =
-                a2ns.at(kb::arities(*m_pt_iter).at(i));
+                a2ns.at(arities.at(i));
             
             for (auto n : ns)
             {
@@ -332,7 +337,7 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
 
                 if (not do_violate_hard_term(nodes, i))
                 {
-                    if (i < kb::arities(*m_pt_iter).size() - 1)
+                    if (i < arities.size() - 1)
                         routine_recursive(nodes, i + 1, i_pivot);
                     else
                         m_targets.push_back(*nodes);
@@ -341,7 +346,7 @@ void proof_graph_t::chain_candidate_generator_t::enumerate()
         }
     };
     
-    std::vector<node_idx_t> nodes(kb::arities(*m_pt_iter).size(), -1);
+    std::vector<node_idx_t> nodes(arities.size(), -1);
 
     for (auto i_pivot : slots_pivot)
         routine_recursive(&nodes, 0, i_pivot);
@@ -441,6 +446,26 @@ proof_graph_t::proof_graph_t(phillip_main_t *main, const std::string &name)
 {
     m_threshold_distance_for_soft_unify =
         m_phillip->param_float("threshold_soft_unify", kb::kb()->get_max_distance());
+    m_max_node_num = m_phillip->param_int("max_node_num", -1);
+    m_max_edge_num = m_phillip->param_int("max_edge_num", -1);
+}
+
+
+bool proof_graph_t::do_interrupt()
+{
+    bool do_stop =
+        (m_max_node_num > 0 and m_nodes.size() >= static_cast<size_t>(m_max_node_num)) or
+        (m_max_edge_num > 0 and m_edges.size() >= static_cast<size_t>(m_max_edge_num));
+
+    if (do_stop)
+        m_phillip->cancellation().stop();
+    else
+        do_stop = m_phillip->cancellation().poll();
+
+    if (do_stop)
+        m_is_timeout = true;
+
+    return do_stop;
 }
 
 
@@ -1408,6 +1433,8 @@ hypernode_idx_t proof_graph_t::chain(
             for (auto it_e2 = it_e1; it_e2 != dep_edges.end(); ++it_e2)
             if (it_e1 != it_e2)
             {
+                if (do_interrupt()) return false;
+
                 edge_idx_t e1(*it_e1), e2(*it_e2);
                 if (e1 > e2) std::swap(e1, e2);
 
@@ -1437,6 +1464,8 @@ hypernode_idx_t proof_graph_t::chain(
             for (auto it_n2 = it_n1; it_n2 != dep_nodes.end(); ++it_n2)
             if (it_n1 != it_n2)
             {
+                if (do_interrupt()) return false;
+
                 node_idx_t n1(*it_n1), n2(*it_n2);
                 const unifier_t *uni = m_mutual_exclusive_nodes.find(n1, n2);
                 
@@ -1567,6 +1596,10 @@ hypernode_idx_t proof_graph_t::chain(
     hash_map<term_t, term_t> subs;
     int depth(get_depth_of_deepest_node(from));
 
+    // NO MORE CHAINING IS PERFORMED ONCE THE GRAPH HAS BEEN INTERRUPTED.
+    if (m_is_timeout or do_interrupt())
+        return -1;
+
     assert(depth >= 0);
     if (not get_substitutions(from, axiom, is_backward, &added, &subs, &conds))
         return -1;
@@ -1582,6 +1615,53 @@ hypernode_idx_t proof_graph_t::chain(
         return -1;
 #endif
 
+    // EQUALITY IN EVIDENCES IN THE AXIOM ARE CONSIDERED AS CONDITIONS.
+    // (NOW, WE DON'T CONSIDER TRUE-EQUALITY LITERALS IN ax_from)
+    std::list< std::pair<term_t, term_t> > neqs;
+    {
+        auto ax_from = (is_backward ? axiom.func.get_rhs() : axiom.func.get_lhs());
+
+        for (auto it = ax_from.begin(); it != ax_from.end(); ++it)
+        if ((*it)->is_equality() and not (*it)->truth)
+        {
+            term_t t1 = (*it)->terms.at(0);
+            term_t t2 = (*it)->terms.at(1);
+
+            if (not t1.is_constant())
+            {
+                auto found = subs.find(t1);
+                if (found != subs.end())
+                    t1 = found->second;
+                else
+                    continue;
+            }
+
+            if (not t2.is_constant())
+            {
+                auto found = subs.find(t2);
+                if (found != subs.end())
+                    t2 = found->second;
+                else
+                    continue;
+            }
+            
+            if (t1 > t2) std::swap(t1, t2);
+            neqs.push_back(std::make_pair(t1, t2));
+        }
+    }
+
+    /* IF AN ISOMORPHIC HYPERNODE HAS BEEN HYPOTHESIZED BY THE SAME AXIOM
+     * FROM THE SAME NODES, SHARE IT INSTEAD OF ADDING A DUPLICATE. */
+    std::string canonical;
+    if (not phillip()->flag("disable_hypernode_sharing"))
+    {
+        canonical = get_canonical_form_of_chain(
+            from, axiom.id, is_backward, added, conds, neqs);
+        auto found = m_maps.canonical_chain_to_hypernode.find(canonical);
+        if (found != m_maps.canonical_chain_to_hypernode.end())
+            return found->second;
+    }
+
     hypernode_idx_t idx_hn_from = add_hypernode(from);
     std::vector<node_idx_t> hn_to(added.size(), -1);
 
@@ -1616,40 +1696,8 @@ hypernode_idx_t proof_graph_t::chain(
                 cond_sub->push_back(std::make_pair(it->first, it->second));
         }
 
-        // EQUALITY IN EVIDENCES IN THE AXIOM ARE CONSIDERED AS CONDITIONS.
-        // (NOW, WE DON'T CONSIDER TRUE-EQUALITY LITERALS IN ax_from)
-        auto ax_from = (is_backward ? axiom.func.get_rhs() : axiom.func.get_lhs());
-        std::list< std::pair<term_t, term_t> >
-            *cond_neq = &m_neqs_of_conditions_for_chain[edge_idx],
-            *cond_sub = &m_subs_of_conditions_for_chain[edge_idx];
-
-        for (auto it = ax_from.begin(); it != ax_from.end(); ++it)
-        if ((*it)->is_equality() and not (*it)->truth)
-        {
-            term_t t1 = (*it)->terms.at(0);
-            term_t t2 = (*it)->terms.at(1);
-
-            if (not t1.is_constant())
-            {
-                auto found = subs.find(t1);
-                if (found != subs.end())
-                    t1 = found->second;
-                else
-                    continue;
-            }
-
-            if (not t2.is_constant())
-            {
-                auto found = subs.find(t2);
-                if (found != subs.end())
-                    t2 = found->second;
-                else
-                    continue;
-            }
-            
-            if (t1 > t2) std::swap(t1, t2);
-            cond_neq->push_back(std::make_pair(t1, t2));
-        }
+        if (not neqs.empty())
+            m_neqs_of_conditions_for_chain[edge_idx] = neqs;
     }
 
     if (phillip_main_t::verbose() >= VERBOSE_4)
@@ -1660,6 +1708,9 @@ hypernode_idx_t proof_graph_t::chain(
         m_maps.axiom_to_hypernodes_backward : m_maps.axiom_to_hypernodes_forward;
     ax2hn[axiom.id].insert(idx_hn_from);
 
+    if (not canonical.empty())
+        m_maps.canonical_chain_to_hypernode[canonical] = idx_hn_to;
+
     /* GENERATE MUTUAL EXCLUSIONS BETWEEN CHAINS */
     bool flag(phillip()->flag("enable_node_based_mutual_exclusive_chain"));
     _generate_mutual_exclusion_for_edges(edge_idx, flag);
@@ -1675,6 +1726,63 @@ hypernode_idx_t proof_graph_t::chain(
 }
 
 
+std::string proof_graph_t::get_canonical_form_of_chain(
+    const std::vector<node_idx_t> &from, axiom_id_t axiom, bool is_backward,
+    const std::vector<literal_t> &lits,
+    const std::set<std::pair<term_t, term_t> > &conds,
+    const std::list<std::pair<term_t, term_t> > &neqs) const
+{
+    // TERMS WHICH ALREADY EXIST IN THE PROOF-GRAPH.
+    hash_set<term_t> terms_from;
+    for (auto n : from)
+    {
+        const literal_t &lit = node(n).literal();
+        terms_from.insert(lit.terms.begin(), lit.terms.end());
+    }
+
+    // UNKNOWN TERMS INTRODUCED BY THE CHAIN ARE RENAMED IN ORDER OF APPEARANCE.
+    hash_map<term_t, int> fresh;
+    auto write_term = [&](std::ostream &os, const term_t &t)
+    {
+        if (t.is_unknown() and terms_from.count(t) == 0)
+        {
+            auto found = fresh.find(t);
+            int idx = (found != fresh.end()) ?
+                found->second : (fresh[t] = static_cast<int>(fresh.size()));
+            os << "$" << idx;
+        }
+        else
+            os << t.string();
+    };
+
+    std::vector<node_idx_t> sorted(from);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::ostringstream os;
+    os << axiom << (is_backward ? "<" : ">");
+    for (auto n : sorted)
+        os << n << ",";
+
+    for (auto lit : lits)
+    {
+        os << "|" << (lit.truth ? "" : "!") << lit.predicate << "(";
+        for (auto t : lit.terms)
+        {
+            write_term(os, t);
+            os << ",";
+        }
+        os << ")";
+    }
+
+    for (auto c : conds)
+        os << "|" << c.first.string() << "=" << c.second.string();
+    for (auto c : neqs)
+        os << "|" << c.first.string() << "!=" << c.second.string();
+
+    return os.str();
+}
+
+
 void proof_graph_t::get_mutual_exclusions(
     const literal_t &target,
     std::list<std::tuple<node_idx_t, unifier_t> > *muex) const
@@ -1817,11 +1925,11 @@ void proof_graph_t::_enumerate_mutual_exclusion_for_inconsistent_nodes(
     {
         kb::arity_id_t id2 = p1.first;
         bool do_reverse = (id1 > id2);
-        const std::list<std::pair<term_idx_t, term_idx_t> >* terms =
+        util::array_view_t<std::pair<term_idx_t, term_idx_t> > terms =
             do_reverse ?
             kb->search_inconsistent_terms(id2, id1) :
             kb->search_inconsistent_terms(id1, id2);
-        if (terms == NULL) continue;
+        if (terms.empty()) continue;
 
         for (auto idx : p1.second)
         {
@@ -1829,7 +1937,7 @@ void proof_graph_t::_enumerate_mutual_exclusion_for_inconsistent_nodes(
             bool is_valid(true);
             unifier_t uni;
 
-            for (auto t : (*terms))
+            for (auto t : terms)
             {
                 const term_t &t1 = target1.terms.at(do_reverse ? t.second : t.first);
                 const term_t &t2 = target2.terms.at(do_reverse ? t.first : t.second);
@@ -256,8 +256,9 @@ public:
         const proof_graph_t *m_graph;
         node_idx_t m_pivot;
 
-        std::set<kb::arity_pattern_t> m_patterns;
-        std::set<kb::arity_pattern_t>::const_iterator m_pt_iter;
+        /** Ids of patterns to enumerate, which are sorted and unique. */
+        std::vector<kb::pattern_id_t> m_patterns;
+        std::vector<kb::pattern_id_t>::const_iterator m_pt_iter;
 
         std::list<std::vector<node_idx_t> > m_targets;
         std::list<std::pair<axiom_id_t, bool> > m_axioms;
@@ -281,6 +282,12 @@ public:
     inline phillip_main_t* phillip() const { return m_phillip; }
     inline void timeout(bool flag) { m_is_timeout = flag; }
     inline bool has_timed_out() const { return m_is_timeout; }
+
+    /** Returns whether the expansion of this graph should be stopped, because
+     *  the inference has been cancelled or the number of nodes or edges has
+     *  exceeded param("max_node_num") or param("max_edge_num").
+     *  If so, this graph is regarded as timed out. */
+    bool do_interrupt();
     inline const std::string& name() const { return m_name; }
 
     /** Deletes logs and enumerate hypernodes to be disregarded.
@@ -577,6 +584,16 @@ protected:
      *  And, update m_vc_unifiable and m_maps.terms_to_sub_node. */
     void _chain_for_unification(node_idx_t i, node_idx_t j);
 
+    /** Is a sub-routine of chain.
+     *  Returns a string which identifies the hypernode hypothesized by a chain,
+     *  where unknown terms introduced by the chain are renamed in order of appearance.
+     *  Chains with the same form hypothesize isomorphic hypernodes. */
+    std::string get_canonical_form_of_chain(
+        const std::vector<node_idx_t> &from, axiom_id_t axiom, bool is_backward,
+        const std::vector<literal_t> &lits,
+        const std::set<std::pair<term_t, term_t> > &conds,
+        const std::list<std::pair<term_t, term_t> > &neqs) const;
+
     inline bool _is_considered_unification(node_idx_t i, node_idx_t j) const;
 
     /** Return highest depth in nodes which given hypernode includes. */
@@ -612,6 +629,7 @@ protected:
     hash_map<std::string, std::string> m_attributes;
 
     float m_threshold_distance_for_soft_unify;
+    int m_max_node_num, m_max_edge_num; /// Budgets. Negative means no limit.
     
     /** Mutual exclusiveness betwen two nodes.
      *  If unifier of third value is satisfied, the node of the first key and the node of the second key cannot be hypothesized together. */
@@ -690,6 +708,10 @@ protected:
         hash_map<term_t, hash_set<node_idx_t> > term_to_nodes;
 
         hash_map<kb::arity_id_t, hash_set<node_idx_t> > arity_to_nodes;
+
+        /** Map from canonical forms of chains to the hypernodes they hypothesized.
+         *  Used to share isomorphic hypernodes instead of duplicating them. */
+        hash_map<std::string, hypernode_idx_t> canonical_chain_to_hypernode;
     } m_maps;
 };
 
@@ -2,6 +2,7 @@
 
 
 #include <iostream>
+#include <cstring>
 #include "./s_expression.h"
 
 namespace phil
@@ -50,25 +51,17 @@ void stack_t::print( std::string *p_out_str ) const
 /** Thanks for https://gist.github.com/240957. */
 reader_t& reader_t::read()
 {
-    bool comment_flag = false;
-    char last_c       = 0;
+    char c, last_c(0);
   
-    while( m_stream.good() )
+    while( get(&c) )
     {
-        char c = m_stream.get();
-
-        m_read_bytes = m_stream.tellg();
         if( '\n' == c ) m_line_num++;
     
         stack_t::stack_type_e type = m_stack.back()->type;
         if( type != stack_t::STRING_STACK and last_c != '\\' and c == ';' )
         {
-            comment_flag = true;
-            continue;
-        }
-        else if( comment_flag )
-        {
-            if( '\n' == c ) comment_flag = false;
+            skip_line();
+            last_c = '\n';
             continue;
         }
 
@@ -80,7 +73,7 @@ reader_t& reader_t::read()
             {
                 /* IF IT WERE TOP STACK, THEN CLEAR. */
                 if( m_stack.size() == 1 ) clear_stack();
-                m_stack.push_back( new_stack( stack_t(stack_t::LIST_STACK) ) );
+                m_stack.push_back( new_stack(stack_t::LIST_STACK) );
             }
             else if( c == ')' )
             {
@@ -91,80 +84,146 @@ reader_t& reader_t::read()
                               << m_stack.back()->to_string() << std::endl;
                     throw;
                 }
-                m_stack[ m_stack.size()-2 ]
-                    ->children.push_back( m_stack.back() );
-                m_stack.pop_back();
-                if( m_stack.back()->children[0]->type == stack_t::TUPLE_STACK and
-                    m_stack.back()->children[0]->children[0]->str == "quote" )
-                {
-                    m_stack[ m_stack.size()-2 ]
-                        ->children.push_back( m_stack.back() );
-                    m_stack.pop_back();
-                }
+                close_stack();
                 m_stack_current = m_stack.back()->children.back();
                 return *this;
             }
             else if( c == '"' )
-                m_stack.push_back( new_stack( stack_t(stack_t::STRING_STACK) ) );
+            {
+                m_stack.push_back( new_stack(stack_t::STRING_STACK) );
+                scan( &m_stack.back()->str, true );
+            }
             else if( is_sexp_separator(c) )
                 break;
             else
             {
-                stack_t s(
-                    stack_t::TUPLE_STACK, std::string(1, c), m_stack_list );
-                m_stack.push_back( new_stack(s) );
+                m_stack.push_back( new_atom(c) );
+                if( c != '\\' )
+                    scan( &m_stack.back()->children[0]->str, false );
             }
             break;
         }
         case stack_t::STRING_STACK:
         {
             if( c == '"' )
+                close_stack();
+            else if( c == '\\' )
             {
-                m_stack[ m_stack.size()-2 ]
-                    ->children.push_back( m_stack.back() );
-                m_stack.pop_back();
-                if( m_stack.back()->children[0]->type == stack_t::TUPLE_STACK and
-                    m_stack.back()->children[0]->children[0]->str == "quote" )
-                {
-                    m_stack[ m_stack.size()-2 ]
-                        ->children.push_back( m_stack.back() );
-                    m_stack.pop_back();
-                }
+                if( get(&c) ) m_stack.back()->str += c;
+                c = '\\';
             }
-            else if( c == '\\' ) m_stack.back()->str += m_stream.get();
-            else if( c != ';'  ) m_stack.back()->str += c;
+            else if( c != ';' )
+                m_stack.back()->str += c;
+            
+            if( m_stack.back()->type == stack_t::STRING_STACK )
+                scan( &m_stack.back()->str, true );
             break;
         }
         case stack_t::TUPLE_STACK:
         {
             if( is_sexp_separator(c) )
             {
-                stack_t *p_atom = m_stack.back();
-                m_stack.pop_back();
-                m_stack.back()->children.push_back(p_atom);
-                if( m_stack.back()->children[0]->type == stack_t::TUPLE_STACK and
-                    m_stack.back()->children[0]->children[0]->str == "quote" )
+                close_stack();
+                --m_cur; /* THE SEPARATOR WILL BE READ AGAIN. */
+                if( '\n' == c ) m_line_num--;
+            }
+            else
+            {
+                std::string &str = m_stack.back()->children[0]->str;
+                if( c == '\\' )
+                {
+                    if( get(&c) ) str += c;
+                    c = '\\';
+                }
+                else
                 {
-                    m_stack[ m_stack.size()-2 ]
-                        ->children.push_back( m_stack.back() );
-                    m_stack.pop_back();
+                    str += c;
+                    scan( &str, false );
                 }
-                m_stream.unget();
             }
-            else if( c == '\\' )
-                m_stack.back()->children[0]->str += m_stream.get();
-            else
-                m_stack.back()->children[0]->str += c;
             break;
         }
         }
         last_c = c;
     }
+
+    m_is_end = true;
     clear_stack();
     return *this;
 }
 
 
+bool reader_t::fill()
+{
+    if( m_stream == NULL or not m_stream->good() ) return false;
+
+    if( m_buffer.empty() ) m_buffer.resize(BLOCK_SIZE);
+    m_block_offset += (m_end - m_begin);
+    m_stream->read( &m_buffer[0], m_buffer.size() );
+
+    m_begin = m_cur = &m_buffer[0];
+    m_end = m_begin + m_stream->gcount();
+    return m_cur != m_end;
+}
+
+
+void reader_t::scan( std::string *out, bool is_string )
+{
+    while( m_cur != m_end or fill() )
+    {
+        const char *begin(m_cur);
+
+        if( is_string )
+        {
+            for( ; m_cur != m_end; ++m_cur )
+            {
+                if( *m_cur == '"' or *m_cur == '\\' or *m_cur == ';' ) break;
+                if( *m_cur == '\n' ) m_line_num++;
+            }
+        }
+        else
+        {
+            for( ; m_cur != m_end; ++m_cur )
+                if( is_sexp_separator(*m_cur) or *m_cur == '\\' or *m_cur == ';' )
+                    break;
+        }
+        
+        out->append( begin, m_cur );
+        if( m_cur != m_end ) return;
+    }
+}
+
+
+void reader_t::skip_line()
+{
+    while( m_cur != m_end or fill() )
+    {
+        const char *p = static_cast<const char*>(
+            std::memchr( m_cur, '\n', m_end - m_cur ));
+        if( p != NULL )
+        {
+            m_cur = p + 1;
+            m_line_num++;
+            return;
+        }
+        m_cur = m_end;
+    }
+}
+
+
+void reader_t::close_stack()
+{
+    m_stack[ m_stack.size()-2 ]->children.push_back( m_stack.back() );
+    m_stack.pop_back();
+    if( m_stack.back()->children[0]->type == stack_t::TUPLE_STACK and
+        m_stack.back()->children[0]->children[0]->str == "quote" )
+    {
+        m_stack[ m_stack.size()-2 ]
+            ->children.push_back( m_stack.back() );
+        m_stack.pop_back();
+    }
+}
+
 }
 
 }
@@ -4,6 +4,7 @@
 #include <string>
 #include <list>
 #include <deque>
+#include <vector>
 #include <ciso646>
 
 
@@ -21,7 +22,7 @@ public:
     enum stack_type_e { LIST_STACK, STRING_STACK, TUPLE_STACK };
     
     stack_type_e type;
-    std::deque<stack_t*> children;
+    std::vector<stack_t*> children;
     std::string str; /**< Content of string-stack instance. */
   
     inline stack_t() : type(LIST_STACK) {}
@@ -41,11 +42,17 @@ public:
 };
 
 
-/** reader of s-expression. */
+/** reader of s-expression.
+ *  Input is read in large blocks, or scanned directly on memory
+ *  when it is given as a memory block such as a mapped file. */
 class reader_t
 {  
 public:
     inline reader_t( std::istream &_stream, const std::string &name="" );
+
+    /** Reads s-expressions on given memory block,
+     *  which must be alive while this is used. */
+    inline reader_t( const char *data, size_t size, const std::string &name="" );
     inline ~reader_t() { clear_stack(); }
     
     /** Read and parse s-expression.  */
@@ -59,25 +66,53 @@ public:
 
     inline const std::string& name() const { return m_name; }
       
-    inline bool is_end()  const { return m_stream.eof(); }
+    inline bool is_end()  const { return m_is_end; }
     inline bool is_root() const { return m_stack.size() == 1; }
     
     inline void clear_stack();
     inline void clear_latest_stack(int n);
         
 private:
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    reader_t(const reader_t&);
+    reader_t& operator=(const reader_t&);
+
     inline static bool is_sexp_separator( char c );
 
     /** Add a new stack and return the pointer of the added stack. */
-    inline stack_t* new_stack( const stack_t &ss );
+    inline stack_t* new_stack( stack_t::stack_type_e type );
+
+    /** Add a new atom which starts with given character. */
+    inline stack_t* new_atom( char c );
+
+    /** Gets the next character. Returns false at the end of input. */
+    inline bool get( char *c );
+
+    /** Reads the next block from the stream. */
+    bool fill();
+
+    /** Appends characters to out while they can be a part of
+     *  a string literal (if is_string is true) or of an atom. */
+    void scan( std::string *out, bool is_string );
+
+    /** Skips characters until the end of the current line. */
+    void skip_line();
+
+    /** Closes the stack on the top, and pops it. */
+    void close_stack();
     
-    std::istream         &m_stream;
+    std::istream         *m_stream;
+    std::vector<char>     m_buffer;
+    const char *m_begin, *m_cur, *m_end; /**< Current block of input. */
+    size_t m_block_offset; /**< Bytes before the current block. */
+    bool   m_is_end;
+
     std::deque<stack_t*>  m_stack;
     std::list<stack_t>    m_stack_list;
     std::string m_name;
     stack_t *m_stack_current;
     size_t   m_line_num;
-    size_t   m_read_bytes;
 };
 
 
@@ -57,9 +57,20 @@ inline std::string stack_t::get_string() const
 
 
 inline reader_t::reader_t( std::istream &_stream, const std::string &name )
-    : m_line_num(1), m_read_bytes(0), m_stream(_stream), m_name(name)
+    : m_stream(&_stream), m_begin(NULL), m_cur(NULL), m_end(NULL),
+      m_block_offset(0), m_is_end(false), m_name(name), m_line_num(1)
 {
-    m_stack.push_back( new_stack( stack_t(stack_t::LIST_STACK) ) );
+    m_stack.push_back( new_stack(stack_t::LIST_STACK) );
+    read();
+};
+
+
+inline reader_t::reader_t(
+    const char *data, size_t size, const std::string &name )
+    : m_stream(NULL), m_begin(data), m_cur(data), m_end(data + size),
+      m_block_offset(0), m_is_end(false), m_name(name), m_line_num(1)
+{
+    m_stack.push_back( new_stack(stack_t::LIST_STACK) );
     read();
 };
 
@@ -73,14 +84,14 @@ inline const std::list<stack_t>& reader_t::get_list() const
 
 
 inline size_t reader_t::get_read_bytes() const
-{ return m_read_bytes; }
+{ return m_block_offset + (m_cur - m_begin); }
 
 
 inline void reader_t::clear_stack()
 {
     m_stack_list.clear();
     m_stack.clear();
-    m_stack.push_back( new_stack( stack_t(stack_t::LIST_STACK) ) );
+    m_stack.push_back( new_stack(stack_t::LIST_STACK) );
 }
 
 
@@ -91,13 +102,32 @@ inline void reader_t::clear_latest_stack(int n)
 }
 
 
-inline stack_t* reader_t::new_stack( const stack_t &ss )
+inline stack_t* reader_t::new_stack( stack_t::stack_type_e type )
 {
-    m_stack_list.push_back(ss);
+    m_stack_list.emplace_back(type);
     return &(m_stack_list.back());
 }
 
 
+inline stack_t* reader_t::new_atom( char c )
+{
+    stack_t *str = new_stack(stack_t::STRING_STACK);
+    str->str.assign(1, c);
+
+    stack_t *tuple = new_stack(stack_t::TUPLE_STACK);
+    tuple->children.push_back(str);
+    return tuple;
+}
+
+
+inline bool reader_t::get( char *c )
+{
+    if( m_cur == m_end and not fill() ) return false;
+    *c = *(m_cur++);
+    return true;
+}
+
+
 inline bool reader_t::is_sexp_separator( char c )
 {
     return c == '('
@@ -72,11 +72,25 @@ public:
 
 #ifdef USE_LP_SOLVE
 private:
+    /** Buffers to build models, which are kept across solving. */
+    struct context_t
+    {
+        ilp::presolver_t presolver;
+
+        std::vector<double> column, row, values;
+        std::vector<int> rowno, colno;
+    };
+
+    /** Builds a model column by column from the presolved problem.
+     *  @param lazy Constraints not to be added, which are added in CPI. Can be NULL. */
     void initialize(
-        const ilp::ilp_problem_t *prob, ::lprec **rec) const;
+        const ilp::ilp_problem_t *prob, ::lprec **rec, context_t *c,
+        const hash_set<ilp::constraint_idx_t> *lazy) const;
     void add_constraint(
         const ilp::ilp_problem_t *prob, ilp::constraint_idx_t idx,
-        ::lprec **rec) const;
+        ::lprec **rec, context_t *c) const;
+
+    static util::object_pool_t<context_t> ms_contexts;
 #endif
 };
 
@@ -104,35 +118,60 @@ public:
 
 protected:
 #ifdef USE_GUROBI
+    /** An environment of Gurobi and buffers to build models,
+     *  which are kept across solving to avoid creating environments,
+     *  which checks the license, for every observation. */
+    struct context_t
+    {
+        std::unique_ptr<GRBEnv> env;
+        ilp::presolver_t presolver;
+
+        std::vector<double> lb, ub, obj;
+        std::vector<char> types;
+
+        std::vector<GRBLinExpr> exprs;
+        std::vector<char> senses;
+        std::vector<double> rhs;
+        std::vector<std::string> names;
+
+        std::vector<int> cols;
+        std::vector<double> coefs, values;
+        std::vector<GRBVar> terms;
+    };
+
     struct model_t
     {
-        model_t(const ilp::ilp_problem_t *p) : prob(p) {}
+        model_t(const ilp::ilp_problem_t *p) : context(&ms_contexts), prob(p) {}
+
+        /* THE MODEL MUST BE DESTRUCTED BEFORE THE CONTEXT IS RETURNED. */
+        util::object_pool_t<context_t>::lease_t context;
 
         std::chrono::time_point<std::chrono::system_clock> begin;
         const ilp::ilp_problem_t *prob;
         std::unique_ptr<GRBModel> model;
-        std::unique_ptr<GRBEnv> env;
-        hash_map<ilp::variable_idx_t, GRBVar> vars;
+        std::vector<GRBVar> vars;
         hash_set<ilp::constraint_idx_t> lazy_cons;
         bool do_cpi;
     };
 
+    static util::object_pool_t<context_t> ms_contexts;
+
     void prepare(model_t&) const;
     ilp::ilp_solution_t optimize(model_t&) const;
 
     double get_timeout(std::chrono::time_point<std::chrono::system_clock> begin) const;
 
-    void add_variables(
-        const ilp::ilp_problem_t *prob,
-        GRBModel *model, hash_map<ilp::variable_idx_t, GRBVar> *vars) const;
-    void add_constraint(
-        GRBModel *model, ilp::constraint_t cons,
-        const hash_map<ilp::variable_idx_t, GRBVar> &vars) const;
+    /** Presolves the problem and adds all columns at once. */
+    void add_variables(model_t &m) const;
 
-    ilp::ilp_solution_t convert(
-        const ilp::ilp_problem_t *prob,
-        GRBModel *model, const hash_map<ilp::variable_idx_t, GRBVar> &vars,
-        const std::string &name = "") const;
+    /** Adds rows of the presolved problem at once. */
+    void add_constraints(model_t &m) const;
+
+    /** Adds a constraint of the original problem, such as a lazy one. */
+    void add_constraint(model_t &m, const ilp::constraint_t &cons) const;
+
+    /** Returns the solution on all variables of the original problem. */
+    ilp::ilp_solution_t convert(const model_t &m) const;
     
 #endif
     int m_thread_num;
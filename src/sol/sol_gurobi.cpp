@@ -74,28 +74,31 @@ bool gurobi_t::is_available(std::list<std::string> *err) const
 #ifdef USE_GUROBI
 
 
+util::object_pool_t<gurobi_t::context_t> gurobi_t::ms_contexts(
+    []() -> gurobi_t::context_t*
+{
+    // CREATING AN ENVIRONMENT CHECKS THE LICENSE, WHICH IS NOT THREAD-SAFE.
+    std::lock_guard<std::mutex> lock(g_mutex_gurobi);
+    context_t *out = new context_t();
+    out->env.reset(new GRBEnv());
+    return out;
+});
+
+
 void gurobi_t::prepare(model_t &m) const
 {
     m.begin = std::chrono::system_clock::now();
 
-    g_mutex_gurobi.lock();
-    {
-        m.env.reset(new GRBEnv());
-        m.model.reset(new GRBModel(*m.env));
-        m.lazy_cons = m.prob->get_lazy_constraints();
-        m.do_cpi = (not m.lazy_cons.empty());
-    }
-    g_mutex_gurobi.unlock();
+    m.model.reset(new GRBModel(*m.context->env));
+    m.lazy_cons = m.prob->get_lazy_constraints();
+    m.do_cpi = (not m.lazy_cons.empty());
 
     if (phillip() != NULL)
     if (phillip()->flag("disable-cpi"))
         m.do_cpi = false;
 
-    add_variables(m.prob, m.model.get(), &m.vars);
-
-    for (int i = 0; i < m.prob->constraints().size(); ++i)
-    if (m.lazy_cons.count(i) == 0 or not m.do_cpi)
-        add_constraint(m.model.get(), m.prob->constraint(i), m.vars);
+    add_variables(m);
+    add_constraints(m);
 
     double timeout = get_timeout(m.begin);
 
@@ -149,8 +152,7 @@ ilp::ilp_solution_t gurobi_t::optimize(model_t &m) const
         }
         else
         {
-            ilp::ilp_solution_t sol =
-                convert(m.prob, m.model.get(), m.vars, m.prob->name());
+            ilp::ilp_solution_t sol = convert(m);
             bool do_break(false);
             bool do_violate_lazy_constraint(false);
 
@@ -163,7 +165,7 @@ ilp::ilp_solution_t gurobi_t::optimize(model_t &m) const
                 {
                     // ADD VIOLATED CONSTRAINTS
                     for (auto it = filtered.begin(); it != filtered.end(); ++it)
-                        add_constraint(m.model.get(), m.prob->constraint(*it), m.vars);
+                        add_constraint(m, m.prob->constraint(*it));
                     GRBEXECUTE(m.model->update());
                     do_violate_lazy_constraint = true;
                 }
@@ -236,73 +238,144 @@ double gurobi_t::get_timeout(
 }
 
 
-void gurobi_t::add_variables(
-    const ilp::ilp_problem_t *prob,
-    GRBModel *model, hash_map<ilp::variable_idx_t, GRBVar> *vars) const
+void gurobi_t::add_variables(model_t &m) const
 {
-    for (int i = 0; i < prob->variables().size(); ++i)
+    context_t *c = m.context.get();
+    ilp::presolver_t &ps = c->presolver;
+    bool do_presolve =
+        (phillip() == NULL) or not phillip()->flag("disable_presolve");
+
+    ps.presolve(m.prob, (m.do_cpi ? &m.lazy_cons : NULL), do_presolve);
+
+    size_t n = ps.num_columns();
+    c->lb.resize(n);
+    c->ub.resize(n);
+    c->obj.resize(n);
+    c->types.resize(n);
+
+    for (size_t j = 0; j < n; ++j)
     {
-        const ilp::variable_t &v = prob->variable(i);
-        double lb(0.0), ub(1.0);
-        
-        if (prob->is_constant_variable(i))
-            lb = ub = prob->const_variable_value(i);
+        c->lb[j] = ps.lower_bound(j);
+        c->ub[j] = ps.upper_bound(j);
+        c->obj[j] = ps.objective(j);
+        c->types[j] = (c->lb[j] == 0.0 and c->ub[j] == 1.0) ? GRB_BINARY : GRB_INTEGER;
+    }
 
+    m.vars.clear();
+
+    if (n > 0)
+    {
         GRBEXECUTE(
-            (*vars)[i] = model->addVar(
-                lb, ub, v.objective_coefficient(),
-                (ub - lb == 1.0) ? GRB_BINARY : GRB_INTEGER))
+            GRBVar *vars = m.model->addVars(
+                &c->lb[0], &c->ub[0], &c->obj[0], &c->types[0], NULL, n);
+            m.vars.assign(vars, vars + n);
+            delete[] vars;
+        );
     }
 
-    GRBEXECUTE(model->update())
+    GRBEXECUTE(m.model->update())
 }
 
 
-void gurobi_t::add_constraint(
-    GRBModel *model, ilp::constraint_t cons,
-    const hash_map<ilp::variable_idx_t, GRBVar> &vars) const
+void gurobi_t::add_constraints(model_t &m) const
 {
-    std::string name = cons.name().substr(0, 32);
-    GRBLinExpr expr;
+    context_t *c = m.context.get();
+    const ilp::presolver_t &ps = c->presolver;
+    const ilp::constraint_matrix_t &mat = ps.matrix();
+    size_t num(0);
 
-    for (auto t = cons.terms().begin(); t != cons.terms().end(); ++t)
-        expr += t->coefficient * vars.at(t->var_idx);
+    c->senses.clear();
+    c->rhs.clear();
+    c->names.clear();
 
-    GRBEXECUTE(
-        switch (cons.operator_type())
+    for (size_t r = 0; r < mat.num_rows(); ++r)
     {
+        if (c->exprs.size() <= num)
+            c->exprs.resize(num + 1);
+
+        GRBLinExpr &expr = c->exprs[num];
+        ps.get_row(r, &c->cols, &c->coefs);
+
+        c->terms.clear();
+        for (auto j : c->cols)
+            c->terms.push_back(m.vars.at(j));
+
+        expr.clear();
+        if (not c->terms.empty())
+            expr.addTerms(&c->coefs[0], &c->terms[0], c->terms.size());
+
+        std::string name = m.prob->constraint(mat.rows[r]).name().substr(0, 32);
+        double lower(mat.lower_bounds[r]), upper(mat.upper_bounds[r]);
+
+        switch (mat.operators[r])
+        {
         case ilp::OPR_EQUAL:
-            model->addConstr(expr, GRB_EQUAL, cons.bound(), name);
-            break;
+            c->senses.push_back(GRB_EQUAL); c->rhs.push_back(upper); break;
         case ilp::OPR_LESS_EQ:
-            model->addConstr(expr, GRB_LESS_EQUAL, cons.upper_bound(), name);
-            break;
+            c->senses.push_back(GRB_LESS_EQUAL); c->rhs.push_back(upper); break;
         case ilp::OPR_GREATER_EQ:
-            model->addConstr(expr, GRB_GREATER_EQUAL, cons.lower_bound(), name);
-            break;
-        case ilp::OPR_RANGE:
-            model->addRange(expr, cons.lower_bound(), cons.upper_bound(), name);
-            break;
-    });
+            c->senses.push_back(GRB_GREATER_EQUAL); c->rhs.push_back(lower); break;
+        default:
+            // RANGE CONSTRAINTS HAVE NO BULK API, BUT THEY ARE RARE.
+            GRBEXECUTE(m.model->addRange(expr, lower, upper, name));
+            continue;
+        }
+
+        c->names.push_back(name);
+        ++num;
+    }
+
+    if (num > 0)
+    {
+        GRBEXECUTE(
+            delete[] m.model->addConstrs(
+                &c->exprs[0], &c->senses[0], &c->rhs[0], &c->names[0], num);
+        );
+    }
 }
 
 
-ilp::ilp_solution_t gurobi_t::convert(
-    const ilp::ilp_problem_t *prob,
-    GRBModel *model, const hash_map<ilp::variable_idx_t, GRBVar> &vars,
-    const std::string &name) const
+void gurobi_t::add_constraint(model_t &m, const ilp::constraint_t &cons) const
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    context_t *c = m.context.get();
+    std::string name = cons.name().substr(0, 32);
+    double lower, upper;
+    GRBLinExpr expr;
+
+    c->presolver.reduce(cons, &c->cols, &c->coefs, &lower, &upper);
+    for (size_t i = 0; i < c->cols.size(); ++i)
+        expr += c->coefs[i] * m.vars.at(c->cols[i]);
+
+    GRBEXECUTE(
+        if (lower == upper)
+            m.model->addConstr(expr, GRB_EQUAL, upper, name);
+        else if (lower > -inf and upper < inf)
+            m.model->addRange(expr, lower, upper, name);
+        else if (lower > -inf)
+            m.model->addConstr(expr, GRB_GREATER_EQUAL, lower, name);
+        else if (upper < inf)
+            m.model->addConstr(expr, GRB_LESS_EQUAL, upper, name);
+    );
+}
+
+
+ilp::ilp_solution_t gurobi_t::convert(const model_t &m) const
 {
-    std::vector<double> values(prob->variables().size(), 0);
-    GRBVar *p_vars = model->getVars();
-    double *p_values = model->get(GRB_DoubleAttr_X, p_vars, values.size());
+    std::vector<double> &values = m.context->values;
+    std::vector<double> out;
 
-    for (int i = 0; i < prob->variables().size(); ++i)
-        values[i] = p_values[i];
+    values.assign(m.vars.size(), 0.0);
+    if (not m.vars.empty())
+    {
+        double *p_values = m.model->get(GRB_DoubleAttr_X, &m.vars[0], m.vars.size());
+        std::copy(p_values, p_values + m.vars.size(), values.begin());
+        delete[] p_values;
+    }
 
-    delete p_vars;
-    delete p_values;
+    m.context->presolver.restore(values, &out);
 
-    return ilp::ilp_solution_t(prob, ilp::SOLUTION_OPTIMAL, values);
+    return ilp::ilp_solution_t(m.prob, ilp::SOLUTION_OPTIMAL, out);
 }
 
 #endif
@@ -78,7 +78,7 @@ void gurobi_k_best_t::solve(
             }
 
             con.set_bound((double)(m_margin - count));
-            add_constraint(m.model.get(), con, m.vars);
+            add_constraint(m, con);
         }
 
         ilp::ilp_solution_t sol = optimize(m);
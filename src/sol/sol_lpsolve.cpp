@@ -31,23 +31,58 @@ void lp_solve_t::solve(
 {
 #ifdef USE_LP_SOLVE
     std::vector<double> vars(prob->variables().size(), 0);
+    hash_set<ilp::constraint_idx_t> lazy_cons(prob->get_lazy_constraints());
+    bool do_cpi(not lazy_cons.empty());
     ::lprec *rec(NULL);
 
+    if (phillip() != NULL)
+    if (phillip()->flag("disable-cpi"))
+        do_cpi = false;
+
+    util::object_pool_t<context_t>::lease_t context(&ms_contexts);
+
     auto begin = std::chrono::system_clock::now();
-    initialize(prob, &rec);
-    
-    int ret = ::solve(rec);
+    initialize(prob, &rec, context.get(), (do_cpi ? &lazy_cons : NULL));
+
     ilp::ilp_solution_t *sol = NULL;
+    bool do_violate_lazy_constraint(false);
+    size_t num_loop(0);
 
-    if (ret == OPTIMAL or ret == SUBOPTIMAL)
+    while (true)
     {
-        ::get_variables(rec, &vars[0]);
+        if (do_cpi and phillip_main_t::verbose() >= VERBOSE_1)
+            util::print_console_fmt("begin: Cutting-Plane-Inference #%d", (num_loop++));
+
+        int ret = ::solve(rec);
+        if (ret != OPTIMAL and ret != SUBOPTIMAL)
+            break;
+
+        context->values.assign(context->presolver.num_columns(), 0.0);
+        if (not context->values.empty())
+            ::get_variables(rec, &context->values[0]);
+        context->presolver.restore(context->values, &vars);
+
         ilp::solution_type_e type = (ret == OPTIMAL) ?
             ilp::SOLUTION_OPTIMAL : ilp::SOLUTION_SUB_OPTIMAL;
+        if (sol != NULL) delete sol;
         sol = new ilp::ilp_solution_t(prob, type, vars);
+        do_violate_lazy_constraint = false;
+
+        if (not do_cpi) break;
+
+        // ADD LAZY CONSTRAINTS WHICH THE SOLUTION VIOLATES.
+        hash_set<ilp::constraint_idx_t> filtered;
+        sol->filter_unsatisfied_constraints(&lazy_cons, &filtered);
+        if (filtered.empty()) break;
+
+        for (auto idx : filtered)
+            add_constraint(prob, idx, &rec, context.get());
+        do_violate_lazy_constraint = true;
+
+        if (do_time_out(begin)) break;
     }
 
-    if (do_time_out(begin))
+    if (sol != NULL and do_time_out(begin))
         sol->timeout(true);
 
     ::delete_lp(rec);
@@ -56,7 +91,7 @@ void lp_solve_t::solve(
     {
         sol = new ilp::ilp_solution_t(
             prob, ilp::SOLUTION_NOT_AVAILABLE,
-            std::vector<double>(0.0, prob->variables().size()));
+            std::vector<double>(prob->variables().size(), 0.0));
     }
     else
     {
@@ -66,6 +101,8 @@ void lp_solve_t::solve(
         ilp::solution_type_e sol_type =
             infer_solution_type(
             timeout_lhs, prob->has_timed_out(), sol->has_timed_out());
+        if (do_violate_lazy_constraint)
+            sol_type = ilp::SOLUTION_NOT_AVAILABLE;
         sol->set_solution_type(sol_type);
     }
 
@@ -118,20 +155,28 @@ void lp_handler(::lprec *lp, void *userhandle, char *buf)
 }
 
 
-void lp_solve_t::initialize(const ilp::ilp_problem_t *prob, ::lprec **rec) const
+util::object_pool_t<lp_solve_t::context_t> lp_solve_t::ms_contexts(
+    []() { return new lp_solve_t::context_t(); });
+
+
+void lp_solve_t::initialize(
+    const ilp::ilp_problem_t *prob, ::lprec **rec, context_t *c,
+    const hash_set<ilp::constraint_idx_t> *lazy) const
 {
-    const std::vector<ilp::variable_t> &variables = prob->variables();
-    const std::vector<ilp::constraint_t> &constraints = prob->constraints();
-    const hash_set<ilp::constraint_idx_t>
-        &lazy_cons = prob->get_lazy_constraints();
-
-    // SETS OBJECTIVE FUNCTIONS.
-    std::vector<double> vars(variables.size() + 1, 0);
-    for (size_t i = 0; i < variables.size(); ++i)
-        vars[i+1] = variables.at(i).objective_coefficient();
-
-    *rec = ::make_lp(0, variables.size());
-    ::set_obj_fn(*rec, &vars[0]);
+    const ilp::presolver_t &ps = c->presolver;
+    const ilp::constraint_matrix_t &mat = ps.matrix();
+    bool do_presolve =
+        (phillip() == NULL) or not phillip()->flag("disable_presolve");
+
+    c->presolver.presolve(prob, lazy, do_presolve);
+
+    int num_rows = static_cast<int>(mat.num_rows());
+    int num_cols = static_cast<int>(ps.num_columns());
+
+    // ALLOCATES ALL ROWS AND COLUMNS AT ONCE TO AVOID REALLOCATION.
+    *rec = ::make_lp(num_rows, 0);
+    ::resize_lp(*rec, num_rows, num_cols);
+
     prob->do_maximize() ?
         ::set_maxim(*rec) : ::set_minim(*rec);
 
@@ -142,53 +187,88 @@ void lp_solve_t::initialize(const ilp::ilp_problem_t *prob, ::lprec **rec) const
     ::set_outputfile(*rec, "");
     ::put_logfunc(*rec, lp_handler, NULL);
 
-    // SETS ALL VARIABLES TO INTEGER.
-    for (size_t i = 0; i < variables.size(); ++i)
+    // SETS TYPES AND RIGHT-HAND-SIDES OF ROWS.
+    c->row.assign(num_rows + 1, 0.0);
+    for (int r = 0; r < num_rows; ++r)
     {
-        ::set_int(*rec, i + 1, true);
-        ::set_upbo(*rec, i + 1, 1.0);
+        switch (mat.operators[r])
+        {
+        case ilp::OPR_EQUAL:
+            ::set_constr_type(*rec, r + 1, EQ);
+            c->row[r + 1] = mat.upper_bounds[r];
+            break;
+        case ilp::OPR_GREATER_EQ:
+            ::set_constr_type(*rec, r + 1, GE);
+            c->row[r + 1] = mat.lower_bounds[r];
+            break;
+        default:
+            ::set_constr_type(*rec, r + 1, LE);
+            c->row[r + 1] = mat.upper_bounds[r];
+            break;
+        }
     }
+    ::set_rh_vec(*rec, &c->row[0]);
+
+    for (int r = 0; r < num_rows; ++r)
+    if (mat.operators[r] == ilp::OPR_RANGE)
+        ::set_rh_range(*rec, r + 1, mat.lower_bounds[r], mat.upper_bounds[r]);
+
+    // ADDS COLUMNS, WHOSE FIRST ELEMENTS ARE COEFFICIENTS IN THE OBJECTIVE FUNCTION.
+    for (int j = 0; j < num_cols; ++j)
+    {
+        c->column.clear();
+        c->rowno.clear();
+
+        double obj = ps.objective(j);
+        if (obj != 0.0)
+        {
+            c->column.push_back(obj);
+            c->rowno.push_back(0);
+        }
+
+        for (size_t k = mat.column_begins[j]; k < mat.column_begins[j + 1]; ++k)
+        {
+            c->column.push_back(mat.values[k]);
+            c->rowno.push_back(mat.row_indices[k] + 1);
+        }
 
-    // ADDS CONSTRAINTS.
-    for (size_t i = 0; i < constraints.size(); ++i)
-        add_constraint(prob, i, rec);
+        ::add_columnex(
+            *rec, static_cast<int>(c->column.size()),
+            (c->column.empty() ? NULL : &c->column[0]),
+            (c->rowno.empty() ? NULL : &c->rowno[0]));
+    }
 
-    // ADDS CONSTRAINTS FOR CONSTANTS.
-    const hash_map<ilp::variable_idx_t, double>
-        &consts = prob->const_variable_values();
-    for (auto it = consts.begin(); it != consts.end(); ++it)
+    // SETS ALL VARIABLES TO INTEGERS WITHIN THE BOUNDS GIVEN BY PRESOLVE.
+    for (int j = 0; j < num_cols; ++j)
     {
-        std::vector<double> vec(variables.size() + 1, 0.0);
-        vec[it->first + 1] = it->second;
-        ::add_constraint(*rec, &vec[0], EQ, it->second);
+        ::set_int(*rec, j + 1, TRUE);
+        ::set_bounds(*rec, j + 1, ps.lower_bound(j), ps.upper_bound(j));
     }
 }
 
 
 void lp_solve_t::add_constraint(
     const ilp::ilp_problem_t *prob, ilp::constraint_idx_t idx,
-    ::lprec **rec) const
+    ::lprec **rec, context_t *c) const
 {
-    const std::vector<ilp::variable_t> &variables = prob->variables();
-    const std::vector<ilp::constraint_t> &constraints = prob->constraints();
-    const ilp::constraint_t &con = constraints.at(idx);
-    std::vector<double> vec(variables.size() + 1, 0.0);
+    const double inf = std::numeric_limits<double>::infinity();
+    double lower, upper;
 
-    for( auto it = con.terms().begin(); it != con.terms().end(); ++it )
-        vec[it->var_idx + 1] = it->coefficient;
+    c->presolver.reduce(prob->constraints().at(idx), &c->colno, &c->row, &lower, &upper);
+    for (auto &col : c->colno) ++col;
 
-    switch (con.operator_type())
+    int n = static_cast<int>(c->row.size());
+    double *row = c->row.empty() ? NULL : &c->row[0];
+    int *colno = c->colno.empty() ? NULL : &c->colno[0];
+
+    if (lower == upper)
+        ::add_constraintex(*rec, n, row, colno, EQ, upper);
+    else
     {
-    case ilp::OPR_EQUAL:
-        ::add_constraint(*rec, &vec[0], EQ, con.bound()); break;
-    case ilp::OPR_LESS_EQ:
-        ::add_constraint(*rec, &vec[0], LE, con.upper_bound()); break;
-    case ilp::OPR_GREATER_EQ:
-        ::add_constraint(*rec, &vec[0], GE, con.lower_bound()); break;
-    case ilp::OPR_RANGE:
-        ::add_constraint(*rec, &vec[0], LE, con.upper_bound());
-        ::add_constraint(*rec, &vec[0], GE, con.lower_bound());
-        break;
+        if (upper < inf)
+            ::add_constraintex(*rec, n, row, colno, LE, upper);
+        if (lower > -inf)
+            ::add_constraintex(*rec, n, row, colno, GE, lower);
     }
 }
 
@@ -160,3 +160,79 @@ class Configure:
         self.params = dict(conf.find('params').items())
 
 
+
+
+SOLUTION_STATES = ['optimal', 'sub-optimal', 'not-available']
+NODE_TYPES = ['underspecified', 'observable', 'hypothesis', 'requirement']
+
+
+## Reads solutions written with "-o format=jsonl" or "-o format=bin".
+#  Yields one dict per observation, in the same layout as the JSON.
+def read_solutions(path):
+    import json, struct
+
+    with open(path, 'rb') as fin:
+        magic = fin.read(8)
+
+        if magic != 'PHILSOL\0':
+            fin.seek(0)
+            for line in fin:
+                yield json.loads(line)
+            return
+
+        version, _ = struct.unpack('<II', fin.read(8))
+        if version != 1:
+            raise ValueError('unsupported version: %d' % version)
+
+        while True:
+            head = fin.read(4)
+            if len(head) < 4: break
+            buf = fin.read(struct.unpack('<I', head)[0])
+            pos = [0]
+
+            def read(fmt):
+                out = struct.unpack_from('<' + fmt, buf, pos[0])
+                pos[0] += struct.calcsize('<' + fmt)
+                return out if len(out) > 1 else out[0]
+
+            def read_str():
+                n = read('I')
+                pos[0] += n
+                return buf[pos[0] - n:pos[0]]
+
+            def read_ids():
+                n = read('I')
+                out = struct.unpack_from('<%di' % n, buf, pos[0])
+                pos[0] += 4 * n
+                return list(out)
+
+            sol = {'name': read_str()}
+            state, obj, t_lhs, t_ilp, t_sol, t_all, to = read('BdffffB')
+            sol['state'] = SOLUTION_STATES[state]
+            sol['objective'] = obj
+            sol['time'] = {'lhs': t_lhs, 'ilp': t_ilp, 'sol': t_sol, 'all': t_all}
+            sol['timeout'] = {'lhs': bool(to & 1), 'ilp': bool(to & 2),
+                              'sol': bool(to & 4), 'all': bool(to & 7)}
+
+            sol['literals'] = []
+            for _ in xrange(read('I')):
+                i, t, d = read('iBi')
+                sol['literals'].append(
+                    {'id': i, 'type': NODE_TYPES[t], 'depth': d, 'literal': read_str()})
+
+            sol['explanations'] = []
+            for _ in xrange(read('I')):
+                i, b = read('iB')
+                tail, head = read_ids(), read_ids()
+                sol['explanations'].append(
+                    {'id': i, 'backward': bool(b), 'tail': tail, 'head': head,
+                     'axiom': read_str()})
+
+            sol['unifications'] = []
+            for _ in xrange(read('I')):
+                i, l1, l2 = read('iii')
+                sol['unifications'].append(
+                    {'id': i, 'l1': l1, 'l2': l2,
+                     'unifier': [read_str() for _ in xrange(read('I'))]})
+
+            yield sol